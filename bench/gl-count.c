@@ -0,0 +1,236 @@
+#include <GL/gl.h>
+#include <EGL/egl.h>
+
+#include "gl-count.h"
+
+#include <dlfcn.h>
+#include <string.h>
+
+typedef void (*gl_count_proc)(void);
+
+static unsigned long gl_count;
+
+/* The driver's own function: libGL exports the core entry points, and the
+   driver's eglGetProcAddress has the rest */
+static gl_count_proc gl_count_real(const char *name)
+{
+    static __eglMustCastToProperFunctionPointerType (*get_proc_address)(
+        const char *);
+    gl_count_proc result = (gl_count_proc) dlsym(RTLD_NEXT, name);
+
+    if (result)
+        return result;
+    if (get_proc_address == NULL)
+        get_proc_address = dlsym(RTLD_NEXT, "eglGetProcAddress");
+    return (gl_count_proc) get_proc_address(name);
+}
+
+/* The functions called in src/ and ftgl/ */
+#define GL_COUNT_FUNCTIONS(V, R)                                               \
+    V(glActiveTexture, (GLenum texture), (texture))                            \
+    V(glAttachShader, (GLuint program, GLuint shader), (program, shader))      \
+    V(glBeginQuery, (GLenum target, GLuint id), (target, id))                  \
+    V(glBindAttribLocation,                                                    \
+      (GLuint program, GLuint index, const GLchar *name),                      \
+      (program, index, name))                                                  \
+    V(glBindBuffer, (GLenum target, GLuint buffer), (target, buffer))          \
+    V(glBindTexture, (GLenum target, GLuint texture), (target, texture))       \
+    V(glBindVertexArray, (GLuint array), (array))                              \
+    V(glBlendFunc, (GLenum sfactor, GLenum dfactor), (sfactor, dfactor))       \
+    V(glBlendFuncSeparate,                                                     \
+      (GLenum srgb, GLenum drgb, GLenum salpha, GLenum dalpha),                \
+      (srgb, drgb, salpha, dalpha))                                            \
+    V(glBufferData,                                                            \
+      (GLenum target, GLsizeiptr size, const void *data, GLenum usage),        \
+      (target, size, data, usage))                                             \
+    V(glBufferStorage,                                                         \
+      (GLenum target, GLsizeiptr size, const void *data, GLbitfield flags),    \
+      (target, size, data, flags))                                             \
+    V(glBufferSubData,                                                         \
+      (GLenum target, GLintptr offset, GLsizeiptr size, const void *data),     \
+      (target, offset, size, data))                                            \
+    R(GLenum, glClientWaitSync,                                                \
+      (GLsync sync, GLbitfield flags, GLuint64 timeout),                       \
+      (sync, flags, timeout))                                                  \
+    V(glCompileShader, (GLuint shader), (shader))                              \
+    R(GLuint, glCreateProgram, (void), ())                                     \
+    R(GLuint, glCreateShader, (GLenum type), (type))                           \
+    V(glDeleteBuffers, (GLsizei n, const GLuint *buffers), (n, buffers))       \
+    V(glDeleteProgram, (GLuint program), (program))                            \
+    V(glDeleteQueries, (GLsizei n, const GLuint *ids), (n, ids))               \
+    V(glDeleteShader, (GLuint shader), (shader))                               \
+    V(glDeleteSync, (GLsync sync), (sync))                                     \
+    V(glDeleteTextures, (GLsizei n, const GLuint *textures), (n, textures))    \
+    V(glDeleteVertexArrays, (GLsizei n, const GLuint *arrays), (n, arrays))    \
+    V(glDisable, (GLenum cap), (cap))                                          \
+    V(glDisableClientState, (GLenum array), (array))                           \
+    V(glDisableVertexAttribArray, (GLuint index), (index))                     \
+    V(glDrawArrays, (GLenum mode, GLint first, GLsizei count),                 \
+      (mode, first, count))                                                    \
+    V(glDrawElements,                                                          \
+      (GLenum mode, GLsizei count, GLenum type, const void *indices),          \
+      (mode, count, type, indices))                                            \
+    V(glDrawElementsBaseVertex,                                                \
+      (GLenum mode, GLsizei count, GLenum type, const void *indices,           \
+       GLint base),                                                            \
+      (mode, count, type, indices, base))                                      \
+    V(glEnable, (GLenum cap), (cap))                                           \
+    V(glEnableClientState, (GLenum array), (array))                            \
+    V(glEnableVertexAttribArray, (GLuint index), (index))                      \
+    V(glEndQuery, (GLenum target), (target))                                   \
+    R(GLsync, glFenceSync, (GLenum condition, GLbitfield flags),               \
+      (condition, flags))                                                      \
+    V(glGenBuffers, (GLsizei n, GLuint *buffers), (n, buffers))                \
+    V(glGenQueries, (GLsizei n, GLuint *ids), (n, ids))                        \
+    V(glGenTextures, (GLsizei n, GLuint *textures), (n, textures))             \
+    V(glGenVertexArrays, (GLsizei n, GLuint *arrays), (n, arrays))             \
+    R(GLint, glGetAttribLocation, (GLuint program, const GLchar *name),        \
+      (program, name))                                                         \
+    V(glGetIntegerv, (GLenum pname, GLint *data), (pname, data))               \
+    V(glGetProgramBinary,                                                      \
+      (GLuint program, GLsizei size, GLsizei *length, GLenum *format,          \
+       void *binary),                                                          \
+      (program, size, length, format, binary))                                 \
+    V(glGetProgramiv, (GLuint program, GLenum pname, GLint *params),           \
+      (program, pname, params))                                                \
+    V(glGetQueryObjectiv, (GLuint id, GLenum pname, GLint *params),            \
+      (id, pname, params))                                                     \
+    V(glGetQueryObjectui64v, (GLuint id, GLenum pname, GLuint64 *params),      \
+      (id, pname, params))                                                     \
+    V(glGetShaderInfoLog,                                                      \
+      (GLuint shader, GLsizei size, GLsizei *length, GLchar *log),             \
+      (shader, size, length, log))                                             \
+    V(glGetShaderiv, (GLuint shader, GLenum pname, GLint *params),             \
+      (shader, pname, params))                                                 \
+    R(const GLubyte *, glGetString, (GLenum name), (name))                     \
+    R(GLint, glGetUniformLocation, (GLuint program, const GLchar *name),       \
+      (program, name))                                                         \
+    R(GLboolean, glIsEnabled, (GLenum cap), (cap))                             \
+    V(glLinkProgram, (GLuint program), (program))                              \
+    R(void *, glMapBufferRange,                                                \
+      (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access),  \
+      (target, offset, length, access))                                        \
+    V(glPixelStorei, (GLenum pname, GLint param), (pname, param))              \
+    V(glPopAttrib, (void), ())                                                 \
+    V(glPopClientAttrib, (void), ())                                           \
+    V(glProgramBinary,                                                         \
+      (GLuint program, GLenum format, const void *binary, GLsizei length),     \
+      (program, format, binary, length))                                       \
+    V(glProgramParameteri, (GLuint program, GLenum pname, GLint value),        \
+      (program, pname, value))                                                 \
+    V(glPushAttrib, (GLbitfield mask), (mask))                                 \
+    V(glPushClientAttrib, (GLbitfield mask), (mask))                           \
+    V(glShaderSource,                                                          \
+      (GLuint shader, GLsizei count, const GLchar *const *string,              \
+       const GLint *length),                                                   \
+      (shader, count, string, length))                                         \
+    V(glTexImage2D,                                                            \
+      (GLenum target, GLint level, GLint internal, GLsizei width,              \
+       GLsizei height, GLint border, GLenum format, GLenum type,                \
+       const void *pixels),                                                    \
+      (target, level, internal, width, height, border, format, type, pixels))  \
+    V(glTexParameteri, (GLenum target, GLenum pname, GLint param),             \
+      (target, pname, param))                                                  \
+    V(glTexSubImage2D,                                                         \
+      (GLenum target, GLint level, GLint x, GLint y, GLsizei width,            \
+       GLsizei height, GLenum format, GLenum type, const void *pixels),        \
+      (target, level, x, y, width, height, format, type, pixels))              \
+    V(glUniform1iv, (GLint location, GLsizei count, const GLint *value),       \
+      (location, count, value))                                                \
+    V(glUniformMatrix4fv,                                                      \
+      (GLint location, GLsizei count, GLboolean transpose,                     \
+       const GLfloat *value),                                                  \
+      (location, count, transpose, value))                                     \
+    R(GLboolean, glUnmapBuffer, (GLenum target), (target))                     \
+    V(glUseProgram, (GLuint program), (program))                               \
+    V(glVertexAttribIPointer,                                                  \
+      (GLuint index, GLint size, GLenum type, GLsizei stride,                  \
+       const void *pointer),                                                   \
+      (index, size, type, stride, pointer))                                    \
+    V(glVertexAttribPointer,                                                   \
+      (GLuint index, GLint size, GLenum type, GLboolean normalized,            \
+       GLsizei stride, const void *pointer),                                   \
+      (index, size, type, normalized, stride, pointer))
+
+#define GL_COUNT_VOID(name, params, args)                                      \
+    void name params                                                           \
+    {                                                                          \
+        static void(*real) params;                                             \
+        if (real == NULL)                                                      \
+            real = (void(*) params) gl_count_real(#name);                      \
+        gl_count++;                                                            \
+        real args;                                                             \
+    }
+
+#define GL_COUNT_RETURN(type, name, params, args)                              \
+    type name params                                                           \
+    {                                                                          \
+        static type(*real) params;                                             \
+        if (real == NULL)                                                      \
+            real = (type(*) params) gl_count_real(#name);                      \
+        gl_count++;                                                            \
+        return real args;                                                      \
+    }
+
+GL_COUNT_FUNCTIONS(GL_COUNT_VOID, GL_COUNT_RETURN)
+
+#define GL_COUNT_ENTRY_VOID(name, params, args) { #name, (gl_count_proc) name },
+#define GL_COUNT_ENTRY_RETURN(type, name, params, args)                        \
+    { #name, (gl_count_proc) name },
+
+static const struct
+{
+    const char *name;
+    gl_count_proc proc;
+} gl_count_entries[] = { GL_COUNT_FUNCTIONS(GL_COUNT_ENTRY_VOID,
+                                            GL_COUNT_ENTRY_RETURN) };
+
+static gl_count_proc gl_count_find(const char *name)
+{
+    for (size_t i = 0;
+         i < sizeof(gl_count_entries) / sizeof(gl_count_entries[0]); ++i)
+    {
+        if (strcmp(gl_count_entries[i].name, name) == 0)
+            return gl_count_entries[i].proc;
+    }
+    return NULL;
+}
+
+__eglMustCastToProperFunctionPointerType eglGetProcAddress(const char *name)
+{
+    static __eglMustCastToProperFunctionPointerType (*real)(const char *);
+    gl_count_proc result = gl_count_find(name);
+
+    if (result)
+        return (__eglMustCastToProperFunctionPointerType) result;
+    if (real == NULL)
+        real = dlsym(RTLD_NEXT, "eglGetProcAddress");
+    return real(name);
+}
+
+gl_count_proc glXGetProcAddressARB(const GLubyte *name)
+{
+    static gl_count_proc (*real)(const GLubyte *);
+    gl_count_proc result = gl_count_find((const char *) name);
+
+    if (result)
+        return result;
+    if (real == NULL)
+        real = dlsym(RTLD_NEXT, "glXGetProcAddressARB");
+    return real ? real(name) : NULL;
+}
+
+gl_count_proc glXGetProcAddress(const GLubyte *name)
+{
+    return glXGetProcAddressARB(name);
+}
+
+void gl_count_reset()
+{
+    gl_count = 0;
+}
+
+unsigned long gl_count_calls()
+{
+    return gl_count;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+/* Counts the GL calls glez makes. gl-count.c defines the GL entry points
+   glez uses in the executable, which needs -rdynamic so that libglez.so
+   binds to them, and returns the same wrappers from the GetProcAddress
+   functions GLEW loads extensions with. Each wrapper counts and calls the
+   driver. */
+
+void gl_count_reset();
+
+unsigned long gl_count_calls();
@@ -0,0 +1,360 @@
+/* Benchmarks: draws the scripted scenes of tests/scenes.c headless and
+   reports per frame the CPU time the render thread spends from glez_begin
+   to glez_end, the frame time up to glFinish, the GL calls glez makes and
+   its draw calls.
+
+   glez-bench [-f fonts] [-d dir] [-n frames] [bench...]
+
+   -f  directory of the DejaVu fonts, /usr/share/fonts/truetype/dejavu by
+       default
+   -d  directory holding data/, "tests" by default
+   -n  frames measured per scene, 100 by default, fewer when they take
+       more than 2 seconds
+
+   "scenes" draws every scene, "lookup" times glyph lookups without GL,
+   "flush" draws a flush per textured rect or string, "shaders" compares
+   the fill rate of the shader variants.
+   Benches named on the command line run alone. With llvmpipe the frame
+   time is mostly rasterization on the CPU: compare CPU times and call
+   counts between builds, frame times only on the same machine. */
+
+#include <GL/glew.h>
+
+#include "glez.h"
+#include "gl-count.h"
+#include "headless.h"
+#include "scenes.h"
+
+#include <texture-atlas.h>
+#include <texture-font.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_WIDTH 1280
+#define BENCH_HEIGHT 720
+
+struct bench
+{
+    const char *name;
+    int (*run)();
+};
+
+static struct
+{
+    const char *font_dir;
+    const char *dir;
+    int frames;
+
+    struct scene_resources resources;
+} bench = { "/usr/share/fonts/truetype/dejavu", "tests", 100 };
+
+struct bench_result
+{
+    double cpu_ms;
+    double frame_ms;
+    double draw_calls;
+    double gl_calls;
+};
+
+static double bench_ms(clockid_t clock)
+{
+    struct timespec now;
+
+    clock_gettime(clock, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+/* Creates the context and glez with options, and loads the scene
+   resources. Returns 0, or -1 when the context is not available. */
+static int bench_start(glez_options_t *options)
+{
+    char data_dir[1024];
+
+    if (headless_init(options->profile) != 0)
+        return -1;
+    headless_resize(BENCH_WIDTH, BENCH_HEIGHT);
+    glez_init_ex(BENCH_WIDTH, BENCH_HEIGHT, options);
+    snprintf(data_dir, sizeof(data_dir), "%s/data", bench.dir);
+    if (scene_load(bench.font_dir, data_dir, &bench.resources) != 0)
+        exit(2);
+    return 0;
+}
+
+static void bench_finish()
+{
+    scene_unload(&bench.resources);
+    glez_shutdown();
+    headless_destroy();
+}
+
+static void bench_frame(const struct scene *scene, struct bench_result *sum)
+{
+    glez_frame_stats_t stats;
+    double start = bench_ms(CLOCK_MONOTONIC);
+    double cpu;
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    gl_count_reset();
+    cpu = bench_ms(CLOCK_THREAD_CPUTIME_ID);
+    glez_begin();
+    scene->draw(&bench.resources, BENCH_WIDTH, BENCH_HEIGHT);
+    glez_end();
+    sum->cpu_ms += bench_ms(CLOCK_THREAD_CPUTIME_ID) - cpu;
+    sum->gl_calls += gl_count_calls();
+    glFinish();
+    sum->frame_ms += bench_ms(CLOCK_MONOTONIC) - start;
+
+    glez_get_frame_stats(&stats);
+    sum->draw_calls += stats.draw_calls;
+}
+
+/* Averages bench.frames frames of scene, or as many as fit in 2 seconds,
+   after warming up until every glyph is in the atlas */
+static void bench_scene(const struct scene *scene, struct bench_result *out)
+{
+    struct bench_result warm = { 0 };
+    glez_frame_stats_t stats;
+    int frames = 0;
+
+    for (int frame = 0; frame < 100; ++frame)
+    {
+        bench_frame(scene, &warm);
+        glez_get_frame_stats(&stats);
+        if (frame > 0 && stats.glyph_misses == 0 && stats.glyphs_pending == 0)
+            break;
+    }
+
+    memset(out, 0, sizeof(*out));
+    while (frames < bench.frames && (frames < 3 || out->frame_ms < 2000))
+    {
+        bench_frame(scene, out);
+        frames++;
+    }
+    out->cpu_ms /= frames;
+    out->frame_ms /= frames;
+    out->draw_calls /= frames;
+    out->gl_calls /= frames;
+}
+
+static void bench_header()
+{
+    printf("%-24s %9s %9s %9s %9s %9s %9s\n", "", "cpu ms", "frame ms", "fps",
+           "draws", "gl calls", "gl/draw");
+}
+
+static void bench_print(const char *name, const struct bench_result *result)
+{
+    printf("%-24s %9.3f %9.3f %9.1f %9.1f %9.1f %9.1f\n", name,
+           result->cpu_ms, result->frame_ms, 1000.0 / result->frame_ms,
+           result->draw_calls, result->gl_calls,
+           result->gl_calls / result->draw_calls);
+}
+
+/* The scene called name with options */
+static int bench_options(const char *name, const char *scene,
+                         glez_options_t *options)
+{
+    struct bench_result result;
+
+    if (bench_start(options) != 0)
+        return -1;
+    bench_scene(scene_find(scene), &result);
+    bench_print(name, &result);
+    bench_finish();
+    return 0;
+}
+
+/* Every scene with the default options */
+static int bench_scenes()
+{
+    glez_options_t options;
+
+    glez_options_default(&options);
+    if (bench_start(&options) != 0)
+        return -1;
+    bench_header();
+    for (const struct scene *scene = scenes; scene->name; ++scene)
+    {
+        struct bench_result result;
+
+        bench_scene(scene, &result);
+        bench_print(scene->name, &result);
+    }
+    bench_finish();
+    return 0;
+}
+
+/* Glyph lookups per second in fonts holding 100, 1,000 and 10,000 glyphs:
+   1x1 bitmaps at consecutive codepoints from U+0020, so the smallest font
+   is mostly found through the ASCII table and the others through the
+   hash table */
+static int bench_lookup()
+{
+    static const size_t counts[] = { 100, 1000, 10000 };
+    static uint32_t codepoints[4096];
+    unsigned char pixel = 255;
+    char path[1024];
+
+    snprintf(path, sizeof(path), "%s/DejaVuSans.ttf", bench.font_dir);
+    printf("%-24s %12s %12s\n", "glyphs", "M lookups/s", "ns/lookup");
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+    {
+        texture_atlas_t *atlas = texture_atlas_new(1024, 1024, 1);
+        texture_font_t *font   = texture_font_new_from_file(atlas, 10, path);
+        texture_glyph_bitmap_t bitmap = { 0 };
+        unsigned state                = 1;
+        size_t lookups                = 0;
+        size_t found                  = 0;
+        double start;
+        double ms;
+
+        if (font == NULL)
+        {
+            texture_atlas_delete(atlas);
+            return -1;
+        }
+        bitmap.rendermode        = font->rendermode;
+        bitmap.outline_thickness = font->outline_thickness;
+        bitmap.width             = 1;
+        bitmap.height            = 1;
+        bitmap.buffer            = &pixel;
+        bitmap.capacity          = 1;
+        for (uint32_t c = 0; c < counts[i]; ++c)
+        {
+            bitmap.codepoint = 0x20 + c;
+            texture_font_commit_glyph(font, atlas, 0, &bitmap);
+        }
+        for (size_t j = 0; j < sizeof(codepoints) / sizeof(codepoints[0]); ++j)
+        {
+            state         = state * 1664525u + 1013904223u;
+            codepoints[j] = 0x20 + (state >> 8) % counts[i];
+        }
+
+        /* About half a second whatever the machine */
+        start = bench_ms(CLOCK_MONOTONIC);
+        do
+        {
+            for (size_t j = 0; j < 1u << 20; ++j)
+                found += texture_font_find_glyph_utf32(
+                             font, codepoints[j % 4096]) != NULL;
+            lookups += 1u << 20;
+            ms = bench_ms(CLOCK_MONOTONIC) - start;
+        } while (ms < 500);
+
+        if (found != lookups)
+            printf("%-24zu missed %zu of %zu\n", counts[i], lookups - found,
+                   lookups);
+        else
+            printf("%-24zu %12.1f %12.2f\n", counts[i], lookups / ms / 1000.0,
+                   ms * 1000000.0 / lookups);
+        texture_font_delete(font);
+        texture_atlas_delete(atlas);
+    }
+    return 0;
+}
+
+/* Cost of a flush: the textures scene alternates 1,000 textured rects
+   with 1,000 one-glyph strings, so with a single texture slot every draw
+   flushes the batch, about 2,000 flushes a frame */
+static int bench_flush()
+{
+    static const int slots[] = { 1, 8 };
+    glez_options_t options;
+
+    bench_header();
+    for (int i = 0; i < 2; ++i)
+    {
+        char name[32];
+
+        glez_options_default(&options);
+        options.texture_slots = slots[i];
+        snprintf(name, sizeof(name), "textures, %d slot%s", slots[i],
+                 slots[i] > 1 ? "s" : "");
+        if (bench_options(name, "textures", &options) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* Fill rate of the ubershader against the per-mode shaders */
+static int bench_shaders()
+{
+    static const char *names[] = { "fill, uber", "fill, auto", "fill, split" };
+    static const int variants[] = { GLEZ_SHADERS_UBER, GLEZ_SHADERS_AUTO,
+                                    GLEZ_SHADERS_SPLIT };
+    glez_options_t options;
+
+    bench_header();
+    for (int i = 0; i < 3; ++i)
+    {
+        glez_options_default(&options);
+        options.shader_variants = variants[i];
+        if (bench_options(names[i], "fill", &options) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+static const struct bench benches[] = { { "scenes", bench_scenes },
+                                        { "lookup", bench_lookup },
+                                        { "flush", bench_flush },
+                                        { "shaders", bench_shaders },
+                                        { NULL, NULL } };
+
+static int bench_selected(const char *name, char **names, int count)
+{
+    if (count == 0)
+        return 1;
+    for (int i = 0; i < count; ++i)
+    {
+        if (strcmp(names[i], name) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int failed = 0;
+    int option;
+
+    while ((option = getopt(argc, argv, "f:d:n:")) != -1)
+    {
+        switch (option)
+        {
+        case 'f':
+            bench.font_dir = optarg;
+            break;
+        case 'd':
+            bench.dir = optarg;
+            break;
+        case 'n':
+            bench.frames = atoi(optarg);
+            if (bench.frames > 0)
+                break;
+            /* fall through */
+        default:
+            fprintf(stderr, "usage: %s [-f fonts] [-d dir] [-n frames] "
+                            "[bench...]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    for (const struct bench *b = benches; b->name; ++b)
+    {
+        if (!bench_selected(b->name, argv + optind, argc - optind))
+            continue;
+        printf("%s\n", b->name);
+        if (b->run() != 0)
+        {
+            printf("could not run %s\n", b->name);
+            failed++;
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -28,6 +28,30 @@ void print_help()
                     "'outline_positive', 'outline_negative' or 'sdf'>\n");
 }
 
+// ---------------------------------------------------------- kerning_pairs ---
+// Collects the non-zero kerning pairs that end with the given glyph
+size_t kerning_pairs(texture_font_t *font, texture_glyph_t *glyph,
+                     kerning_t *pairs)
+{
+    size_t i, count = 0;
+
+    /* Starts at index 1 since 0 is for the special background glyph */
+    for (i = 1; i < font->glyphs->size; ++i)
+    {
+        texture_glyph_t *prev =
+            *(texture_glyph_t **) vector_get(font->glyphs, i);
+        float kerning =
+            texture_font_get_kerning(font, prev->codepoint, glyph->codepoint);
+        if (kerning != 0)
+        {
+            pairs[count].codepoint = prev->codepoint;
+            pairs[count].kerning   = kerning;
+            ++count;
+        }
+    }
+    return count;
+}
+
 // ------------------------------------------------------------------- main ---
 int main(int argc, char **argv)
 {
@@ -307,14 +331,17 @@ int main(int argc, char **argv)
     size_t texture_size      = atlas->width * atlas->height * atlas->depth;
     size_t glyph_count       = font->glyphs->size;
     size_t max_kerning_count = 1;
+    size_t kerning_count;
+    kerning_t *kernings      = malloc(glyph_count * sizeof(kerning_t));
     for (i = 0; i < glyph_count; ++i)
     {
         texture_glyph_t *glyph =
             *(texture_glyph_t **) vector_get(font->glyphs, i);
 
-        if (vector_size(glyph->kerning) > max_kerning_count)
+        kerning_count = kerning_pairs(font, glyph, kernings);
+        if (kerning_count > max_kerning_count)
         {
-            max_kerning_count = vector_size(glyph->kerning);
+            max_kerning_count = kerning_count;
         }
     }
 
@@ -511,22 +538,22 @@ int main(int argc, char **argv)
         fprintf(file, "%ff, %ff, ", glyph->advance_x, glyph->advance_y);
         fprintf(file, "%ff, %ff, %ff, %ff, ", glyph->s0, glyph->t0, glyph->s1,
                 glyph->t1);
-        fprintf(file, "%" PRIzu ", ", vector_size(glyph->kerning));
-        if (vector_size(glyph->kerning) == 0)
+        kerning_count = kerning_pairs(font, glyph, kernings);
+        fprintf(file, "%" PRIzu ", ", kerning_count);
+        if (kerning_count == 0)
         {
             fprintf(file, "0");
         }
         else
         {
             fprintf(file, "{ ");
-            for (j = 0; j < vector_size(glyph->kerning); ++j)
+            for (j = 0; j < kerning_count; ++j)
             {
-                kerning_t *kerning =
-                    (kerning_t *) vector_get(glyph->kerning, j);
+                kerning_t *kerning = &kernings[j];
 
                 fprintf(file, "{%u, %ff}", kerning->codepoint,
                         kerning->kerning);
-                if (j < (vector_size(glyph->kerning) - 1))
+                if (j < (kerning_count - 1))
                 {
                     fprintf(file, ", ");
                 }
@@ -536,6 +563,7 @@ int main(int argc, char **argv)
         fprintf(file, " },\n");
     }
     fprintf(file, " }\n};\n");
+    free(kernings);
 
     fprintf(file, "#ifdef __cplusplus\n"
                   "}\n"
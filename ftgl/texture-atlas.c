@@ -33,7 +33,15 @@ texture_atlas_t *texture_atlas_new(const size_t width, const size_t height,
     self->height = height;
     self->depth  = depth;
     self->id     = 0;
-    self->dirty  = 1;
+    self->dirty  = 0;
+
+    self->dirty_region.x      = 0;
+    self->dirty_region.y      = 0;
+    self->dirty_region.width  = 0;
+    self->dirty_region.height = 0;
+    self->texture_width       = 0;
+    self->texture_height      = 0;
+    texture_atlas_mark_dirty(self, 0, 0, width, height);
 
     vector_push_back(self->nodes, &node);
     self->data =
@@ -90,9 +98,59 @@ void texture_atlas_set_region(texture_atlas_t *self, const size_t x,
         memcpy(self->data + ((y + i) * self->width + x) * charsize * depth,
                data + (i * stride) * charsize, width * charsize * depth);
     }
+    texture_atlas_mark_dirty(self, x, y, width, height);
+}
+
+// ----------------------------------------------- texture_atlas_mark_dirty ---
+void texture_atlas_mark_dirty(texture_atlas_t *self, const size_t x,
+                              const size_t y, const size_t width,
+                              const size_t height)
+{
+    ivec4 *region = &self->dirty_region;
+    size_t x1, y1;
+
+    assert(self);
+
+    if (width == 0 || height == 0)
+        return;
+
+    if (region->width == 0)
+    {
+        region->x      = x;
+        region->y      = y;
+        region->width  = width;
+        region->height = height;
+    }
+    else
+    {
+        x1 = region->x + region->width;
+        y1 = region->y + region->height;
+        if (x + width > x1)
+            x1 = x + width;
+        if (y + height > y1)
+            y1 = y + height;
+        if (x < (size_t) region->x)
+            region->x = x;
+        if (y < (size_t) region->y)
+            region->y = y;
+        region->width  = x1 - region->x;
+        region->height = y1 - region->y;
+    }
     self->dirty = 1;
 }
 
+// ---------------------------------------------- texture_atlas_reset_dirty ---
+void texture_atlas_reset_dirty(texture_atlas_t *self)
+{
+    assert(self);
+
+    self->dirty               = 0;
+    self->dirty_region.x      = 0;
+    self->dirty_region.y      = 0;
+    self->dirty_region.width  = 0;
+    self->dirty_region.height = 0;
+}
+
 // ------------------------------------------------------ texture_atlas_fit ---
 int texture_atlas_fit(texture_atlas_t *self, const size_t index,
                       const size_t width, const size_t height)
@@ -254,4 +312,5 @@ void texture_atlas_clear(texture_atlas_t *self)
 
     vector_push_back(self->nodes, &node);
     memset(self->data, 0, self->width * self->height * self->depth);
+    texture_atlas_mark_dirty(self, 0, 0, self->width, self->height);
 }
@@ -116,6 +116,22 @@ typedef struct texture_atlas_t
      */
     char dirty;
 
+    /**
+     * Union of the regions written since the dirty state was last reset,
+     * as x, y, width, height. Empty (zero width) when nothing changed.
+     */
+    ivec4 dirty_region;
+
+    /**
+     * Width of the texture storage last allocated for id
+     */
+    size_t texture_width;
+
+    /**
+     * Height of the texture storage last allocated for id
+     */
+    size_t texture_height;
+
 } texture_atlas_t;
 
 /**
@@ -167,6 +183,28 @@ void texture_atlas_set_region(texture_atlas_t *self, const size_t x,
                               const size_t height, const unsigned char *data,
                               const size_t stride);
 
+/**
+ *  Mark a region of the atlas as modified, growing the dirty region to
+ *  include it.
+ *
+ *  @param self   a texture atlas structure
+ *  @param x      x coordinate the region
+ *  @param y      y coordinate the region
+ *  @param width  width of the region
+ *  @param height height of the region
+ *
+ */
+void texture_atlas_mark_dirty(texture_atlas_t *self, const size_t x,
+                              const size_t y, const size_t width,
+                              const size_t height);
+
+/**
+ *  Forget the dirty region once it has been uploaded.
+ *
+ *  @param self   a texture atlas structure
+ */
+void texture_atlas_reset_dirty(texture_atlas_t *self);
+
 /**
  *  Remove all allocated regions from the atlas.
  *
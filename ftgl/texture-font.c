@@ -11,6 +11,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include <math.h>
 #include "distance-field.h"
@@ -38,38 +39,93 @@ const struct
 } FT_Errors[] =
 #include FT_ERRORS_H
 
-    // ------------------------------------------------- texture_font_load_face
-    // ---
-    static int texture_font_load_face(texture_font_t * self, float size,
-                                      FT_Library *library, FT_Face *face)
+
+/* One FreeType library is shared by every font; it is created with the first
+ * reference and released with the last one. */
+static FT_Library texture_font_library;
+static size_t texture_font_library_refs;
+
+// ------------------------------------------ texture_font_library_acquire ---
+FT_Library texture_font_library_acquire(void)
+{
+    FT_Error error;
+
+    if (texture_font_library_refs == 0)
+    {
+        error = FT_Init_FreeType(&texture_font_library);
+        if (error)
+        {
+            fprintf(stderr, "FT_Error (0x%02x) : %s\n", FT_Errors[error].code,
+                    FT_Errors[error].message);
+            return NULL;
+        }
+    }
+    ++texture_font_library_refs;
+    return texture_font_library;
+}
+
+// ------------------------------------------ texture_font_library_release ---
+void texture_font_library_release(void)
+{
+    assert(texture_font_library_refs > 0);
+
+    if (--texture_font_library_refs == 0)
+    {
+        FT_Done_FreeType(texture_font_library);
+        texture_font_library = NULL;
+    }
+}
+
+// -------------------------------------------------- texture_font_face_size ---
+static int texture_font_face_size(FT_Face face, float size)
 {
     FT_Error error;
     FT_Matrix matrix = { (int) ((1.0 / HRES) * 0x10000L),
                          (int) ((0.0) * 0x10000L), (int) ((0.0) * 0x10000L),
                          (int) ((1.0) * 0x10000L) };
 
-    assert(library);
+    assert(face);
     assert(size);
 
-    /* Initialize library */
-    error = FT_Init_FreeType(library);
+    /* Set char size */
+    error = FT_Set_Char_Size(face, (int) (size * HRES), 0, DPI * HRES, DPI);
+
     if (error)
     {
-        fprintf(stderr, "FT_Error (0x%02x) : %s\n", FT_Errors[error].code,
-                FT_Errors[error].message);
-        goto cleanup;
+        fprintf(stderr, "FT_Error (line %d, code 0x%02x) : %s\n", __LINE__,
+                FT_Errors[error].code, FT_Errors[error].message);
+        return 0;
     }
 
-    /* Load face */
+    /* Set transform matrix */
+    FT_Set_Transform(face, &matrix, NULL);
+
+    return 1;
+}
+
+// ------------------------------------------------- texture_font_set_size ---
+static int texture_font_set_size(texture_font_t *self, float size)
+{
+    return texture_font_face_size(self->face, size);
+}
+
+// ------------------------------------------------ texture_font_new_face ---
+static FT_Face texture_font_new_face(const texture_font_t *self,
+                                     FT_Library library)
+{
+    /* For a location the switch does not know */
+    FT_Error error = FT_Err_Invalid_Argument;
+    FT_Face face;
+
     switch (self->location)
     {
     case TEXTURE_FONT_FILE:
-        error = FT_New_Face(*library, self->filename, 0, face);
+        error = FT_New_Face(library, self->filename, 0, &face);
         break;
 
     case TEXTURE_FONT_MEMORY:
-        error = FT_New_Memory_Face(*library, self->memory.base,
-                                   self->memory.size, 0, face);
+        error = FT_New_Memory_Face(library, self->memory.base,
+                                   self->memory.size, 0, &face);
         break;
     }
 
@@ -77,39 +133,71 @@ const struct
     {
         fprintf(stderr, "FT_Error (line %d, code 0x%02x) : %s\n", __LINE__,
                 FT_Errors[error].code, FT_Errors[error].message);
-        goto cleanup_library;
+        return NULL;
     }
 
     /* Select charmap */
-    error = FT_Select_Charmap(*face, FT_ENCODING_UNICODE);
+    error = FT_Select_Charmap(face, FT_ENCODING_UNICODE);
     if (error)
     {
         fprintf(stderr, "FT_Error (line %d, code 0x%02x) : %s\n", __LINE__,
                 FT_Errors[error].code, FT_Errors[error].message);
-        goto cleanup_face;
+        FT_Done_Face(face);
+        return NULL;
     }
 
-    /* Set char size */
-    error = FT_Set_Char_Size(*face, (int) (size * HRES), 0, DPI * HRES, DPI);
+    return face;
+}
 
-    if (error)
+// ------------------------------------------------ texture_font_load_face ---
+static int texture_font_load_face(texture_font_t *self)
+{
+    assert(!self->face);
+
+    /* Initialize library */
+    self->library = texture_font_library_acquire();
+    if (!self->library)
+        return 0;
+
+    /* Load face */
+    self->face = texture_font_new_face(self, self->library);
+    if (!self->face)
     {
-        fprintf(stderr, "FT_Error (line %d, code 0x%02x) : %s\n", __LINE__,
-                FT_Errors[error].code, FT_Errors[error].message);
-        goto cleanup_face;
+        texture_font_library_release();
+        self->library = NULL;
+        return 0;
     }
 
-    /* Set transform matrix */
-    FT_Set_Transform(*face, &matrix, NULL);
-
     return 1;
+}
 
-cleanup_face:
-    FT_Done_Face(*face);
-cleanup_library:
-    FT_Done_FreeType(*library);
-cleanup:
-    return 0;
+// ------------------------------------------------ texture_font_open_face ---
+FT_Face texture_font_open_face(const texture_font_t *self,
+                               FT_Library library)
+{
+    FT_Face face = texture_font_new_face(self, library);
+
+    if (face && !texture_font_face_size(face, self->size))
+    {
+        FT_Done_Face(face);
+        return NULL;
+    }
+    return face;
+}
+
+// ----------------------------------------------- texture_font_close_face ---
+static void texture_font_close_face(texture_font_t *self)
+{
+    if (self->face)
+    {
+        FT_Done_Face(self->face);
+        self->face = NULL;
+    }
+    if (self->library)
+    {
+        texture_font_library_release();
+        self->library = NULL;
+    }
 }
 
 // ------------------------------------------------------ texture_glyph_new ---
@@ -136,7 +224,8 @@ texture_glyph_t *texture_glyph_new(void)
     self->t0                = 0.0;
     self->s1                = 0.0;
     self->t1                = 0.0;
-    self->kerning           = vector_new(sizeof(kerning_t));
+    self->font              = NULL;
+    self->page              = 0;
     return self;
 }
 
@@ -144,7 +233,6 @@ texture_glyph_t *texture_glyph_new(void)
 void texture_glyph_delete(texture_glyph_t *self)
 {
     assert(self);
-    vector_delete(self->kerning);
     free(self);
 }
 
@@ -152,63 +240,113 @@ void texture_glyph_delete(texture_glyph_t *self)
 float texture_glyph_get_kerning(const texture_glyph_t *self,
                                 const char *codepoint)
 {
-    size_t i;
-    uint32_t ucodepoint = utf8_to_utf32(codepoint);
-
     assert(self);
-    for (i = 0; i < vector_size(self->kerning); ++i)
+
+    if (!self->font)
+        return 0;
+
+    return texture_font_get_kerning(self->font, utf8_to_utf32(codepoint),
+                                    self->codepoint);
+}
+
+// ---------------------------------------------- texture_font_kerning_hash ---
+static uint32_t texture_font_kerning_hash(uint32_t left, uint32_t right)
+{
+    uint32_t hash = left * 0x9E3779B1u ^ right * 0x85EBCA77u;
+    hash ^= hash >> 15;
+    return hash;
+}
+
+// ---------------------------------------------- texture_font_kerning_grow ---
+static void texture_font_kerning_grow(texture_font_t *self)
+{
+    size_t i, j, capacity;
+    texture_font_kerning_t *map;
+
+    capacity =
+        self->kerning_map_capacity ? self->kerning_map_capacity * 2 : 256;
+    map = calloc(capacity, sizeof(texture_font_kerning_t));
+    if (map == NULL)
     {
-        kerning_t *kerning = (kerning_t *) vector_get(self->kerning, i);
-        if (kerning->codepoint == ucodepoint)
-        {
-            return kerning->kerning;
-        }
+        fprintf(stderr, "line %d: No more memory for allocating data\n",
+                __LINE__);
+        exit(EXIT_FAILURE);
     }
-    return 0;
+
+    for (i = 0; i < self->kerning_map_capacity; ++i)
+    {
+        texture_font_kerning_t *pair = &self->kerning_map[i];
+        if (!pair->used)
+            continue;
+        j = texture_font_kerning_hash(pair->left, pair->right) &
+            (capacity - 1);
+        while (map[j].used)
+            j = (j + 1) & (capacity - 1);
+        map[j] = *pair;
+    }
+
+    free(self->kerning_map);
+    self->kerning_map          = map;
+    self->kerning_map_capacity = capacity;
 }
 
-// ------------------------------------------ texture_font_generate_kerning ---
-void texture_font_generate_kerning(texture_font_t *self, FT_Library *library,
-                                   FT_Face *face)
+// ----------------------------------------------- texture_font_get_kerning ---
+float texture_font_get_kerning(texture_font_t *self, uint32_t left,
+                               uint32_t right)
 {
-    size_t i, j;
-    FT_UInt glyph_index, prev_index;
-    texture_glyph_t *glyph, *prev_glyph;
+    size_t i;
     FT_Vector kerning;
+    texture_font_kerning_t *pair;
 
     assert(self);
 
-    /* For each glyph couple combination, check if kerning is necessary */
-    /* Starts at index 1 since 0 is for the special backgroudn glyph */
-    for (i = 1; i < self->glyphs->size; ++i)
-    {
-        glyph       = *(texture_glyph_t **) vector_get(self->glyphs, i);
-        glyph_index = FT_Get_Char_Index(*face, glyph->codepoint);
-        vector_clear(glyph->kerning);
+    /* Fonts without a kern table never pay for a lookup */
+    if (!self->kerning || !self->face || !FT_HAS_KERNING(self->face))
+        return 0;
+
+    if (left == (uint32_t) -1 || right == (uint32_t) -1)
+        return 0;
 
-        for (j = 1; j < self->glyphs->size; ++j)
+    if (self->kerning_map_capacity)
+    {
+        i = texture_font_kerning_hash(left, right) &
+            (self->kerning_map_capacity - 1);
+        while (self->kerning_map[i].used)
         {
-            prev_glyph = *(texture_glyph_t **) vector_get(self->glyphs, j);
-            prev_index = FT_Get_Char_Index(*face, prev_glyph->codepoint);
-            FT_Get_Kerning(*face, prev_index, glyph_index, FT_KERNING_UNFITTED,
-                           &kerning);
-            // printf("%c(%d)-%c(%d): %ld\n",
-            //       prev_glyph->codepoint, prev_glyph->codepoint,
-            //       glyph_index, glyph_index, kerning.x);
-            if (kerning.x)
-            {
-                kerning_t k = { prev_glyph->codepoint,
-                                kerning.x / (float) (HRESf * HRESf) };
-                vector_push_back(glyph->kerning, &k);
-            }
+            pair = &self->kerning_map[i];
+            if (pair->left == left && pair->right == right)
+                return pair->kerning;
+            i = (i + 1) & (self->kerning_map_capacity - 1);
         }
     }
+
+    /* First time this pair is seen: ask FreeType once and remember the
+     * result, zero included, so misses are O(1) from now on. */
+    if ((self->kerning_map_size + 1) * 2 > self->kerning_map_capacity)
+        texture_font_kerning_grow(self);
+
+    FT_Get_Kerning(self->face, FT_Get_Char_Index(self->face, left),
+                   FT_Get_Char_Index(self->face, right), FT_KERNING_UNFITTED,
+                   &kerning);
+
+    i = texture_font_kerning_hash(left, right) &
+        (self->kerning_map_capacity - 1);
+    while (self->kerning_map[i].used)
+        i = (i + 1) & (self->kerning_map_capacity - 1);
+
+    pair          = &self->kerning_map[i];
+    pair->used    = 1;
+    pair->left    = left;
+    pair->right   = right;
+    pair->kerning = kerning.x / (float) (HRESf * HRESf);
+    ++self->kerning_map_size;
+
+    return pair->kerning;
 }
 
 // ------------------------------------------------------ texture_font_init ---
 static int texture_font_init(texture_font_t *self)
 {
-    FT_Library library;
     FT_Face face;
     FT_Size_Metrics metrics;
 
@@ -236,9 +374,16 @@ static int texture_font_init(texture_font_t *self)
     self->lcd_weights[3] = 0x40;
     self->lcd_weights[4] = 0x10;
 
-    if (!texture_font_load_face(self, self->size * 100.f, &library, &face))
+    if (!texture_font_load_face(self))
         return -1;
 
+    /* Metrics are read at a hundredfold size for precision, then the face
+     * is set to its final size once and kept there for glyph loading. */
+    if (!texture_font_set_size(self, self->size * 100.f))
+        return -1;
+
+    face = self->face;
+
     self->underline_position =
         face->underline_position / (float) (HRESf * HRESf) * self->size;
     self->underline_position = roundf(self->underline_position);
@@ -260,8 +405,9 @@ static int texture_font_init(texture_font_t *self)
     self->descender = (metrics.descender >> 6) / 100.0;
     self->height    = (metrics.height >> 6) / 100.0;
     self->linegap   = self->height - self->ascender + self->descender;
-    FT_Done_Face(face);
-    FT_Done_FreeType(library);
+
+    if (!texture_font_set_size(self, self->size))
+        return -1;
 
     /* NULL is a special glyph */
     texture_font_get_glyph(self, NULL);
@@ -354,106 +500,227 @@ void texture_font_delete(texture_font_t *self)
     }
 
     vector_delete(self->glyphs);
+    free(self->glyph_map);
+    free(self->kerning_map);
+    texture_font_close_face(self);
     free(self);
 }
 
-texture_glyph_t *texture_font_find_glyph(texture_font_t *self,
-                                         const char *codepoint)
+// ------------------------------------------------ texture_font_glyph_hash ---
+/* Glyphs are keyed by codepoint, render mode and outline thickness. The
+ * special NULL glyph (codepoint -1) ignores the latter two. */
+static uint32_t texture_font_glyph_hash(uint32_t codepoint,
+                                        rendermode_t rendermode,
+                                        float outline_thickness)
+{
+    uint32_t thickness_bits = 0;
+    uint32_t hash;
+
+    if (outline_thickness != 0.0f)
+        memcpy(&thickness_bits, &outline_thickness, sizeof(thickness_bits));
+
+    hash = codepoint * 0x9E3779B1u;
+    hash ^= (uint32_t) rendermode * 0x85EBCA77u;
+    hash ^= thickness_bits * 0xC2B2AE3Du;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+static int texture_font_glyph_matches(const texture_glyph_t *glyph,
+                                      uint32_t codepoint,
+                                      rendermode_t rendermode,
+                                      float outline_thickness)
+{
+    // If codepoint is -1, we don't care about outline type or thickness
+    return (glyph->codepoint == codepoint) &&
+           ((codepoint == (uint32_t) -1) ||
+            ((glyph->rendermode == rendermode) &&
+             (glyph->outline_thickness == outline_thickness)));
+}
+
+// ------------------------------------------- texture_font_ascii_variant ---
+static texture_font_ascii_t *
+texture_font_ascii_variant(texture_font_t *self, rendermode_t rendermode,
+                           float outline_thickness)
 {
     size_t i;
-    texture_glyph_t *glyph;
-    uint32_t ucodepoint = utf8_to_utf32(codepoint);
 
-    for (i = 0; i < self->glyphs->size; ++i)
+    for (i = 0; i < TEXTURE_FONT_ASCII_VARIANTS; ++i)
     {
-        glyph = *(texture_glyph_t **) vector_get(self->glyphs, i);
-        // If codepoint is -1, we don't care about outline type or thickness
-        if ((glyph->codepoint == ucodepoint) &&
-            ((ucodepoint == -1) ||
-             ((glyph->rendermode == self->rendermode) &&
-              (glyph->outline_thickness == self->outline_thickness))))
-        {
-            return glyph;
-        }
+        texture_font_ascii_t *variant = &self->ascii[i];
+        if (variant->used && variant->rendermode == rendermode &&
+            variant->outline_thickness == outline_thickness)
+            return variant;
     }
-
     return NULL;
 }
 
-// ------------------------------------------------ texture_font_load_glyph ---
-int texture_font_load_glyph(texture_font_t *self, const char *codepoint)
+// ------------------------------------------------ texture_font_map_grow ---
+static void texture_font_map_grow(texture_font_t *self)
 {
-    size_t i, x, y;
+    size_t i, j, capacity;
+    texture_glyph_t **map;
 
-    FT_Library library;
-    FT_Error error;
-    FT_Face face;
-    FT_Glyph ft_glyph;
-    FT_GlyphSlot slot;
-    FT_Bitmap ft_bitmap;
+    capacity = self->glyph_map_capacity ? self->glyph_map_capacity * 2 : 64;
+    map      = calloc(capacity, sizeof(texture_glyph_t *));
+    if (map == NULL)
+    {
+        fprintf(stderr, "line %d: No more memory for allocating data\n",
+                __LINE__);
+        exit(EXIT_FAILURE);
+    }
 
-    FT_UInt glyph_index;
-    texture_glyph_t *glyph;
-    FT_Int32 flags    = 0;
-    int ft_glyph_top  = 0;
-    int ft_glyph_left = 0;
+    for (i = 0; i < self->glyph_map_capacity; ++i)
+    {
+        texture_glyph_t *glyph = self->glyph_map[i];
+        if (glyph == NULL)
+            continue;
+        j = texture_font_glyph_hash(glyph->codepoint, glyph->rendermode,
+                                    glyph->outline_thickness) &
+            (capacity - 1);
+        while (map[j])
+            j = (j + 1) & (capacity - 1);
+        map[j] = glyph;
+    }
 
-    ivec4 region;
-    size_t missed = 0;
+    free(self->glyph_map);
+    self->glyph_map          = map;
+    self->glyph_map_capacity = capacity;
+}
 
-    if (!texture_font_load_face(self, self->size, &library, &face))
-        return 0;
+// ---------------------------------------------- texture_font_index_glyph ---
+/* Adds a freshly created glyph to the glyph vector and to the lookup
+ * structures used by texture_font_find_glyph. */
+static void texture_font_index_glyph(texture_font_t *self,
+                                     texture_glyph_t *glyph)
+{
+    size_t i;
+    uint32_t codepoint          = glyph->codepoint;
+    rendermode_t rendermode     = glyph->rendermode;
+    float outline_thickness     = glyph->outline_thickness;
+    texture_font_ascii_t *ascii = NULL;
 
-    /* Check if codepoint has been already loaded */
-    if (texture_font_find_glyph(self, codepoint))
+    glyph->font = self;
+    vector_push_back(self->glyphs, &glyph);
+
+    if (codepoint == (uint32_t) -1)
     {
-        FT_Done_Face(face);
-        FT_Done_FreeType(library);
-        return 1;
+        rendermode        = RENDER_NORMAL;
+        outline_thickness = 0.0f;
     }
 
-    /* codepoint NULL is special : it is used for line drawing (overline,
-     * underline, strikethrough) and background.
-     */
-    if (!codepoint)
+    /* Keep the load factor at or below one half */
+    if ((self->glyph_map_size + 1) * 2 > self->glyph_map_capacity)
+        texture_font_map_grow(self);
+
+    i = texture_font_glyph_hash(codepoint, rendermode, outline_thickness) &
+        (self->glyph_map_capacity - 1);
+    while (self->glyph_map[i])
+        i = (i + 1) & (self->glyph_map_capacity - 1);
+    self->glyph_map[i] = glyph;
+    ++self->glyph_map_size;
+
+    if (codepoint < TEXTURE_FONT_ASCII_FIRST ||
+        codepoint >= TEXTURE_FONT_ASCII_FIRST + TEXTURE_FONT_ASCII_COUNT)
+        return;
+
+    /* A variant claims an ASCII table with its first ASCII glyph, so an
+     * empty entry in a claimed table is an authoritative miss. Variants
+     * that find every table taken stay on the hash path. */
+    ascii = texture_font_ascii_variant(self, rendermode, outline_thickness);
+    for (i = 0; ascii == NULL && i < TEXTURE_FONT_ASCII_VARIANTS; ++i)
     {
-        ivec4 region           = texture_atlas_get_region(self->atlas, 5, 5);
-        texture_glyph_t *glyph = texture_glyph_new();
-        static unsigned char data[4 * 4 * 3] = {
-            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
-        };
-        if (region.x < 0)
+        if (!self->ascii[i].used)
         {
-            fprintf(stderr, "Texture atlas is full (line %d)\n", __LINE__);
-            FT_Done_Face(face);
-            FT_Done_FreeType(library);
-            return 0;
+            ascii                    = &self->ascii[i];
+            ascii->used              = 1;
+            ascii->rendermode        = rendermode;
+            ascii->outline_thickness = outline_thickness;
         }
-        texture_atlas_set_region(self->atlas, region.x, region.y, 4, 4, data,
-                                 0);
-        glyph->codepoint = -1;
-        glyph->s0        = (region.x + 2) / (float) self->atlas->width;
-        glyph->t0        = (region.y + 2) / (float) self->atlas->height;
-        glyph->s1        = (region.x + 3) / (float) self->atlas->width;
-        glyph->t1        = (region.y + 3) / (float) self->atlas->height;
-        vector_push_back(self->glyphs, &glyph);
+    }
+    if (ascii)
+        ascii->glyphs[codepoint - TEXTURE_FONT_ASCII_FIRST] = glyph;
+}
 
-        FT_Done_Face(face);
-        FT_Done_FreeType(library);
-        return 1;
+// --------------------------------------- texture_font_find_glyph_variant ---
+texture_glyph_t *texture_font_find_glyph_variant(texture_font_t *self,
+                                                 uint32_t codepoint,
+                                                 rendermode_t rendermode,
+                                                 float outline_thickness)
+{
+    size_t i;
+    texture_glyph_t *glyph;
+
+    if (codepoint - TEXTURE_FONT_ASCII_FIRST < TEXTURE_FONT_ASCII_COUNT)
+    {
+        texture_font_ascii_t *ascii =
+            texture_font_ascii_variant(self, rendermode, outline_thickness);
+        if (ascii)
+            return ascii->glyphs[codepoint - TEXTURE_FONT_ASCII_FIRST];
     }
 
-    flags         = 0;
-    ft_glyph_top  = 0;
-    ft_glyph_left = 0;
-    glyph_index = FT_Get_Char_Index(face, (FT_ULong) utf8_to_utf32(codepoint));
+    if (self->glyph_map_size == 0)
+        return NULL;
+
+    if (codepoint == (uint32_t) -1)
+    {
+        rendermode        = RENDER_NORMAL;
+        outline_thickness = 0.0f;
+    }
+
+    i = texture_font_glyph_hash(codepoint, rendermode, outline_thickness) &
+        (self->glyph_map_capacity - 1);
+    while ((glyph = self->glyph_map[i]))
+    {
+        if (texture_font_glyph_matches(glyph, codepoint, rendermode,
+                                       outline_thickness))
+            return glyph;
+        i = (i + 1) & (self->glyph_map_capacity - 1);
+    }
+
+    return NULL;
+}
+
+// ----------------------------------------- texture_font_find_glyph_utf32 ---
+texture_glyph_t *texture_font_find_glyph_utf32(texture_font_t *self,
+                                               uint32_t codepoint)
+{
+    return texture_font_find_glyph_variant(self, codepoint, self->rendermode,
+                                           self->outline_thickness);
+}
+
+// ----------------------------------------------- texture_font_find_glyph ---
+texture_glyph_t *texture_font_find_glyph(texture_font_t *self,
+                                         const char *codepoint)
+{
+    return texture_font_find_glyph_utf32(self, utf8_to_utf32(codepoint));
+}
+
+// ---------------------------------------------- texture_font_render_glyph ---
+int texture_font_render_glyph(const texture_font_t *self, FT_Library library,
+                              FT_Face face, uint32_t codepoint,
+                              rendermode_t rendermode, float outline_thickness,
+                              texture_glyph_bitmap_t *bitmap)
+{
+    size_t i;
+
+    FT_Error error;
+    FT_Glyph ft_glyph = NULL;
+    FT_GlyphSlot slot;
+    FT_Bitmap ft_bitmap;
+
+    FT_UInt glyph_index;
+    FT_Int32 flags    = 0;
+    int ft_glyph_top  = 0;
+    int ft_glyph_left = 0;
+    size_t depth      = self->atlas->depth;
+
+    glyph_index = FT_Get_Char_Index(face, (FT_ULong) codepoint);
     // WARNING: We use texture-atlas depth to guess if user wants
     //          LCD subpixel rendering
 
-    if (self->rendermode != RENDER_NORMAL &&
-        self->rendermode != RENDER_SIGNED_DISTANCE_FIELD)
+    if (rendermode != RENDER_NORMAL &&
+        rendermode != RENDER_SIGNED_DISTANCE_FIELD)
     {
         flags |= FT_LOAD_NO_BITMAP;
     }
@@ -471,14 +738,15 @@ int texture_font_load_glyph(texture_font_t *self, const char *codepoint)
         flags |= FT_LOAD_FORCE_AUTOHINT;
     }
 
-    if (self->atlas->depth == 3)
+    if (depth == 3)
     {
         FT_Library_SetLcdFilter(library, FT_LCD_FILTER_LIGHT);
         flags |= FT_LOAD_TARGET_LCD;
 
         if (self->filtering)
         {
-            FT_Library_SetLcdFilterWeights(library, self->lcd_weights);
+            FT_Library_SetLcdFilterWeights(library,
+                                           (unsigned char *) self->lcd_weights);
         }
     }
 
@@ -487,13 +755,11 @@ int texture_font_load_glyph(texture_font_t *self, const char *codepoint)
     {
         fprintf(stderr, "FT_Error (line %d, code 0x%02x) : %s\n", __LINE__,
                 FT_Errors[error].code, FT_Errors[error].message);
-        FT_Done_Face(face);
-        FT_Done_FreeType(library);
         return 0;
     }
 
-    if (self->rendermode == RENDER_NORMAL ||
-        self->rendermode == RENDER_SIGNED_DISTANCE_FIELD)
+    if (rendermode == RENDER_NORMAL ||
+        rendermode == RENDER_SIGNED_DISTANCE_FIELD)
     {
         slot          = face->glyph;
         ft_bitmap     = slot->bitmap;
@@ -514,7 +780,7 @@ int texture_font_load_glyph(texture_font_t *self, const char *codepoint)
             goto cleanup_stroker;
         }
 
-        FT_Stroker_Set(stroker, (int) (self->outline_thickness * HRES),
+        FT_Stroker_Set(stroker, (int) (outline_thickness * HRES),
                        FT_STROKER_LINECAP_ROUND, FT_STROKER_LINEJOIN_ROUND, 0);
 
         error = FT_Get_Glyph(face->glyph, &ft_glyph);
@@ -526,11 +792,11 @@ int texture_font_load_glyph(texture_font_t *self, const char *codepoint)
             goto cleanup_stroker;
         }
 
-        if (self->rendermode == RENDER_OUTLINE_EDGE)
+        if (rendermode == RENDER_OUTLINE_EDGE)
             error = FT_Glyph_Stroke(&ft_glyph, stroker, 1);
-        else if (self->rendermode == RENDER_OUTLINE_POSITIVE)
+        else if (rendermode == RENDER_OUTLINE_POSITIVE)
             error = FT_Glyph_StrokeBorder(&ft_glyph, stroker, 0, 1);
-        else if (self->rendermode == RENDER_OUTLINE_NEGATIVE)
+        else if (rendermode == RENDER_OUTLINE_NEGATIVE)
             error = FT_Glyph_StrokeBorder(&ft_glyph, stroker, 1, 1);
 
         if (error)
@@ -540,7 +806,7 @@ int texture_font_load_glyph(texture_font_t *self, const char *codepoint)
             goto cleanup_stroker;
         }
 
-        if (self->atlas->depth == 1)
+        if (depth == 1)
             error = FT_Glyph_To_Bitmap(&ft_glyph, FT_RENDER_MODE_NORMAL, 0, 1);
         else
             error = FT_Glyph_To_Bitmap(&ft_glyph, FT_RENDER_MODE_LCD, 0, 1);
@@ -562,8 +828,8 @@ int texture_font_load_glyph(texture_font_t *self, const char *codepoint)
 
         if (error)
         {
-            FT_Done_Face(face);
-            FT_Done_FreeType(library);
+            if (ft_glyph)
+                FT_Done_Glyph(ft_glyph);
             return 0;
         }
     }
@@ -576,91 +842,171 @@ int texture_font_load_glyph(texture_font_t *self, const char *codepoint)
         int bottom;
     } padding = { 0, 0, 1, 1 };
 
-    if (self->rendermode == RENDER_SIGNED_DISTANCE_FIELD)
+    if (rendermode == RENDER_SIGNED_DISTANCE_FIELD)
     {
         padding.top  = 1;
         padding.left = 1;
     }
 
-    size_t src_w = ft_bitmap.width / self->atlas->depth;
+    size_t src_w = ft_bitmap.width / depth;
     size_t src_h = ft_bitmap.rows;
 
     size_t tgt_w = src_w + padding.left + padding.right;
     size_t tgt_h = src_h + padding.top + padding.bottom;
+    size_t size  = tgt_w * tgt_h * depth;
 
-    region = texture_atlas_get_region(self->atlas, tgt_w, tgt_h);
-
-    if (region.x < 0)
+    /* The buffer is kept from one glyph to the next */
+    if (size > bitmap->capacity)
     {
-        fprintf(stderr, "Texture atlas is full (line %d)\n", __LINE__);
-        FT_Done_Face(face);
-        FT_Done_FreeType(library);
-        return 0;
+        unsigned char *buffer = realloc(bitmap->buffer, size);
+        if (buffer == NULL)
+        {
+            if (ft_glyph)
+                FT_Done_Glyph(ft_glyph);
+            return 0;
+        }
+        bitmap->buffer   = buffer;
+        bitmap->capacity = size;
     }
-
-    x = region.x;
-    y = region.y;
-
-    unsigned char *buffer =
-        calloc(tgt_w * tgt_h * self->atlas->depth, sizeof(unsigned char));
+    memset(bitmap->buffer, 0, size);
 
     unsigned char *dst_ptr =
-        buffer + (padding.top * tgt_w + padding.left) * self->atlas->depth;
+        bitmap->buffer + (padding.top * tgt_w + padding.left) * depth;
     unsigned char *src_ptr = ft_bitmap.buffer;
     for (i = 0; i < src_h; i++)
     {
         // difference between width and pitch:
         // https://www.freetype.org/freetype2/docs/reference/ft2-basic_types.html#FT_Bitmap
         memcpy(dst_ptr, src_ptr, ft_bitmap.width);
-        dst_ptr += tgt_w * self->atlas->depth;
+        dst_ptr += tgt_w * depth;
         src_ptr += ft_bitmap.pitch;
     }
 
-    if (self->rendermode == RENDER_SIGNED_DISTANCE_FIELD)
+    if (ft_glyph)
+        FT_Done_Glyph(ft_glyph);
+
+    if (rendermode == RENDER_SIGNED_DISTANCE_FIELD)
     {
-        unsigned char *sdf = make_distance_mapb(buffer, tgt_w, tgt_h);
-        free(buffer);
-        buffer = sdf;
+        unsigned char *sdf = make_distance_mapb(bitmap->buffer, tgt_w, tgt_h);
+        memcpy(bitmap->buffer, sdf, size);
+        free(sdf);
     }
 
-    texture_atlas_set_region(self->atlas, x, y, tgt_w, tgt_h, buffer,
-                             tgt_w * self->atlas->depth);
-
-    free(buffer);
-
-    glyph                    = texture_glyph_new();
-    glyph->codepoint         = utf8_to_utf32(codepoint);
-    glyph->width             = tgt_w;
-    glyph->height            = tgt_h;
-    glyph->rendermode        = self->rendermode;
-    glyph->outline_thickness = self->outline_thickness;
-    glyph->offset_x          = ft_glyph_left;
-    glyph->offset_y          = ft_glyph_top;
-    glyph->s0                = x / (float) self->atlas->width;
-    glyph->t0                = y / (float) self->atlas->height;
-    glyph->s1                = (x + glyph->width) / (float) self->atlas->width;
-    glyph->t1 = (y + glyph->height) / (float) self->atlas->height;
+    bitmap->codepoint         = codepoint;
+    bitmap->rendermode        = rendermode;
+    bitmap->outline_thickness = outline_thickness;
+    bitmap->width             = tgt_w;
+    bitmap->height            = tgt_h;
+    bitmap->offset_x          = ft_glyph_left;
+    bitmap->offset_y          = ft_glyph_top;
 
     // Discard hinting to get advance
     FT_Load_Glyph(face, glyph_index, FT_LOAD_RENDER | FT_LOAD_NO_HINTING);
-    slot             = face->glyph;
-    glyph->advance_x = slot->advance.x / HRESf;
-    glyph->advance_y = slot->advance.y / HRESf;
+    slot              = face->glyph;
+    bitmap->advance_x = slot->advance.x / HRESf;
+    bitmap->advance_y = slot->advance.y / HRESf;
 
-    vector_push_back(self->glyphs, &glyph);
+    return 1;
+}
 
-    if (self->rendermode != RENDER_NORMAL &&
-        self->rendermode != RENDER_SIGNED_DISTANCE_FIELD)
-        FT_Done_Glyph(ft_glyph);
+// ---------------------------------------------- texture_font_commit_glyph ---
+int texture_font_commit_glyph(texture_font_t *self, texture_atlas_t *atlas,
+                              size_t page,
+                              const texture_glyph_bitmap_t *bitmap)
+{
+    texture_glyph_t *glyph;
+    ivec4 region;
+    size_t x, y;
+
+    if (texture_font_find_glyph_variant(self, bitmap->codepoint,
+                                        bitmap->rendermode,
+                                        bitmap->outline_thickness))
+        return 1;
+
+    region = texture_atlas_get_region(atlas, bitmap->width, bitmap->height);
+
+    if (region.x < 0)
+        return 0;
 
-    texture_font_generate_kerning(self, &library, &face);
+    x = region.x;
+    y = region.y;
 
-    FT_Done_Face(face);
-    FT_Done_FreeType(library);
+    texture_atlas_set_region(atlas, x, y, bitmap->width, bitmap->height,
+                             bitmap->buffer, bitmap->width * atlas->depth);
+
+    glyph                    = texture_glyph_new();
+    glyph->codepoint         = bitmap->codepoint;
+    glyph->width             = bitmap->width;
+    glyph->height            = bitmap->height;
+    glyph->rendermode        = bitmap->rendermode;
+    glyph->outline_thickness = bitmap->outline_thickness;
+    glyph->offset_x          = bitmap->offset_x;
+    glyph->offset_y          = bitmap->offset_y;
+    glyph->s0                = x / (float) atlas->width;
+    glyph->t0                = y / (float) atlas->height;
+    glyph->s1                = (x + glyph->width) / (float) atlas->width;
+    glyph->t1                = (y + glyph->height) / (float) atlas->height;
+    glyph->advance_x         = bitmap->advance_x;
+    glyph->advance_y         = bitmap->advance_y;
+    glyph->page              = page;
+
+    texture_font_index_glyph(self, glyph);
 
     return 1;
 }
 
+// ------------------------------------------------ texture_font_load_glyph ---
+int texture_font_load_glyph(texture_font_t *self, const char *codepoint)
+{
+    texture_glyph_bitmap_t bitmap = { 0 };
+    int result;
+
+    /* Check if codepoint has been already loaded */
+    if (texture_font_find_glyph(self, codepoint))
+        return 1;
+
+    /* codepoint NULL is special : it is used for line drawing (overline,
+     * underline, strikethrough) and background.
+     */
+    if (!codepoint)
+    {
+        ivec4 region           = texture_atlas_get_region(self->atlas, 5, 5);
+        texture_glyph_t *glyph = texture_glyph_new();
+        static unsigned char data[4 * 4 * 3] = {
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+        };
+        if (region.x < 0)
+        {
+            fprintf(stderr, "Texture atlas is full (line %d)\n", __LINE__);
+            return 0;
+        }
+        texture_atlas_set_region(self->atlas, region.x, region.y, 4, 4, data,
+                                 0);
+        glyph->codepoint = -1;
+        glyph->s0        = (region.x + 2) / (float) self->atlas->width;
+        glyph->t0        = (region.y + 2) / (float) self->atlas->height;
+        glyph->s1        = (region.x + 3) / (float) self->atlas->width;
+        glyph->t1        = (region.y + 3) / (float) self->atlas->height;
+        texture_font_index_glyph(self, glyph);
+
+        return 1;
+    }
+
+    result = texture_font_render_glyph(self, self->library, self->face,
+                                       utf8_to_utf32(codepoint),
+                                       self->rendermode,
+                                       self->outline_thickness, &bitmap);
+    if (result && !texture_font_commit_glyph(self, self->atlas, 0, &bitmap))
+    {
+        fprintf(stderr, "Texture atlas is full (line %d)\n", __LINE__);
+        result = 0;
+    }
+    free(bitmap.buffer);
+    return result;
+}
+
 // ----------------------------------------------- texture_font_load_glyphs ---
 size_t texture_font_load_glyphs(texture_font_t *self, const char *codepoints)
 {
@@ -8,6 +8,8 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
 
 #ifdef __cplusplus
 extern "C" {
@@ -175,9 +177,9 @@ typedef struct texture_glyph_t
     float t1;
 
     /**
-     * A vector of kerning pairs relative to this glyph.
+     * Font this glyph belongs to, used to look up kerning pairs.
      */
-    vector_t *kerning;
+    struct texture_font_t *font;
 
     /**
      * Mode this glyph was rendered
@@ -189,8 +191,115 @@ typedef struct texture_glyph_t
      */
     float outline_thickness;
 
+    /**
+     * Atlas page the glyph was placed in, see texture_font_commit_glyph.
+     * Zero for the font's atlas.
+     */
+    size_t page;
+
 } texture_glyph_t;
 
+/**
+ * A glyph rendered by texture_font_render_glyph and not yet placed in an
+ * atlas. Rendering only reads the font, so it can run on another thread
+ * with its own FreeType library and face.
+ */
+typedef struct texture_glyph_bitmap_t
+{
+    uint32_t codepoint;
+    rendermode_t rendermode;
+    float outline_thickness;
+
+    /**
+     * Size of the padded bitmap in pixels
+     */
+    size_t width;
+    size_t height;
+    int offset_x;
+    int offset_y;
+    float advance_x;
+    float advance_y;
+
+    /**
+     * width * height * atlas depth bytes. Reused, and grown when needed,
+     * by the next texture_font_render_glyph.
+     */
+    unsigned char *buffer;
+    size_t capacity;
+
+} texture_glyph_bitmap_t;
+
+/**
+ * A lazily filled entry of the per-font kerning pair table.
+ */
+typedef struct texture_font_kerning_t
+{
+    /**
+     * Left Unicode codepoint of the pair in UTF-32 LE encoding.
+     */
+    uint32_t left;
+
+    /**
+     * Right Unicode codepoint of the pair in UTF-32 LE encoding.
+     */
+    uint32_t right;
+
+    /**
+     * Kerning value (in fractional pixels), zero for pairs without kerning.
+     */
+    float kerning;
+
+    /**
+     * Whether this slot holds a pair.
+     */
+    int used;
+
+} texture_font_kerning_t;
+
+/**
+ * First codepoint of the dense printable ASCII glyph table.
+ */
+#define TEXTURE_FONT_ASCII_FIRST 32
+
+/**
+ * Number of codepoints in the dense printable ASCII glyph table.
+ */
+#define TEXTURE_FONT_ASCII_COUNT 95
+
+/**
+ * Number of (rendermode, outline thickness) variants that get a dense
+ * printable ASCII glyph table.
+ */
+#define TEXTURE_FONT_ASCII_VARIANTS 4
+
+/**
+ * Direct lookup table of printable ASCII glyphs for one render variant.
+ */
+typedef struct texture_font_ascii_t
+{
+    /**
+     * Whether this table has been claimed by a variant
+     */
+    int used;
+
+    /**
+     * Mode the glyphs in this table were rendered
+     */
+    rendermode_t rendermode;
+
+    /**
+     * Outline thickness the glyphs in this table were rendered with
+     */
+    float outline_thickness;
+
+    /**
+     * Glyphs indexed by codepoint - TEXTURE_FONT_ASCII_FIRST, NULL if not
+     * loaded yet
+     */
+    texture_glyph_t *glyphs[TEXTURE_FONT_ASCII_COUNT];
+
+} texture_font_ascii_t;
+
 /**
  *  Texture font structure.
  */
@@ -201,6 +310,43 @@ typedef struct texture_font_t
      */
     vector_t *glyphs;
 
+    /**
+     * Open-addressing hash index of glyphs, keyed by codepoint, render mode
+     * and outline thickness. Capacity is a power of two.
+     */
+    texture_glyph_t **glyph_map;
+
+    /**
+     * Number of slots in glyph_map.
+     */
+    size_t glyph_map_capacity;
+
+    /**
+     * Number of glyphs stored in glyph_map.
+     */
+    size_t glyph_map_size;
+
+    /**
+     * Dense printable ASCII tables for the most used render variants.
+     */
+    texture_font_ascii_t ascii[TEXTURE_FONT_ASCII_VARIANTS];
+
+    /**
+     * Open-addressing table of kerning pairs shared by all glyphs, filled
+     * on first lookup of each pair. Capacity is a power of two.
+     */
+    texture_font_kerning_t *kerning_map;
+
+    /**
+     * Number of slots in kerning_map.
+     */
+    size_t kerning_map_capacity;
+
+    /**
+     * Number of pairs stored in kerning_map.
+     */
+    size_t kerning_map_size;
+
     /**
      * Atlas structure to store glyphs data.
      */
@@ -236,6 +382,17 @@ typedef struct texture_font_t
      */
     float size;
 
+    /**
+     * FreeType library the face was opened with (shared by all fonts)
+     */
+    FT_Library library;
+
+    /**
+     * FreeType face, opened and sized once when the font is created and
+     * kept until the font is deleted
+     */
+    FT_Face face;
+
     /**
      * Whether to use autohint when rendering font
      */
@@ -317,6 +474,21 @@ typedef struct texture_font_t
 
 } texture_font_t;
 
+/**
+ * Take a reference on the FreeType library shared by all texture fonts,
+ * creating it if needed. Holding a reference keeps the library alive while
+ * no font exists.
+ *
+ * @return The shared library, or NULL if FreeType failed to initialize
+ */
+FT_Library texture_font_library_acquire(void);
+
+/**
+ * Drop a reference taken with texture_font_library_acquire. The library is
+ * destroyed with its last reference.
+ */
+void texture_font_library_release(void);
+
 /**
  * This function creates a new texture font from given filename and size.  The
  * texture atlas is used to store glyph on demand. Note the depth of the atlas
@@ -388,6 +560,79 @@ texture_glyph_t *texture_font_get_glyph(texture_font_t *self,
 texture_glyph_t *texture_font_find_glyph(texture_font_t *self,
                                          const char *codepoint);
 
+/**
+ * Request an already loaded glyph from the font, in the font's current
+ * render mode and outline thickness.
+ *
+ * @param self      A valid texture font
+ * @param codepoint Character codepoint in UTF-32 encoding.
+ *
+ * @return A pointer on the glyph or 0 if the glyph is not loaded
+ */
+texture_glyph_t *texture_font_find_glyph_utf32(texture_font_t *self,
+                                               uint32_t codepoint);
+
+/**
+ * Request an already loaded glyph from the font, in the given render mode
+ * and outline thickness.
+ *
+ * @param self              A valid texture font
+ * @param codepoint         Character codepoint in UTF-32 encoding.
+ * @param rendermode        Render mode of the glyph
+ * @param outline_thickness Outline thickness of the glyph
+ *
+ * @return A pointer on the glyph or 0 if the glyph is not loaded
+ */
+texture_glyph_t *texture_font_find_glyph_variant(texture_font_t *self,
+                                                 uint32_t codepoint,
+                                                 rendermode_t rendermode,
+                                                 float outline_thickness);
+
+/**
+ * Open another face on the font's file or memory, set to the font's size,
+ * for texture_font_render_glyph on a thread other than the font's.
+ *
+ * @param self    A valid texture font
+ * @param library FreeType library owning the new face
+ *
+ * @return The face, to be released with FT_Done_Face, or NULL on error
+ */
+FT_Face texture_font_open_face(const texture_font_t *self,
+                               FT_Library library);
+
+/**
+ * Render a glyph without touching the atlas or the glyph table.
+ *
+ * @param self              A valid texture font
+ * @param library           Library of face
+ * @param face              The font's face or one from texture_font_open_face
+ * @param codepoint         Character codepoint in UTF-32 encoding
+ * @param rendermode        Render mode of the glyph
+ * @param outline_thickness Outline thickness of the glyph
+ * @param bitmap            Receives the glyph
+ *
+ * @return One if the glyph could be rendered, zero if not.
+ */
+int texture_font_render_glyph(const texture_font_t *self, FT_Library library,
+                              FT_Face face, uint32_t codepoint,
+                              rendermode_t rendermode, float outline_thickness,
+                              texture_glyph_bitmap_t *bitmap);
+
+/**
+ * Place a rendered glyph in an atlas and make it findable. Does nothing if
+ * the glyph was loaded in the meantime.
+ *
+ * @param self   A valid texture font
+ * @param atlas  The font's atlas, or another one of the same depth
+ * @param page   Stored in the glyph so the caller can find atlas again
+ * @param bitmap A glyph from texture_font_render_glyph
+ *
+ * @return One if the glyph is loaded, zero if atlas is full.
+ */
+int texture_font_commit_glyph(texture_font_t *self, texture_atlas_t *atlas,
+                              size_t page,
+                              const texture_glyph_bitmap_t *bitmap);
+
 /**
  * Request the loading of a given glyph.
  *
@@ -434,6 +679,20 @@ void texture_font_enlarge_atlas(texture_font_t *self, size_t width_new,
 float texture_glyph_get_kerning(const texture_glyph_t *self,
                                 const char *codepoint);
 
+/**
+ * Get the kerning between two horizontal glyphs of a font. Pairs are looked
+ * up in FreeType on first use and cached; fonts without a kern table
+ * always return zero.
+ *
+ * @param self  A valid texture font
+ * @param left  Codepoint of the preceding character in UTF-32 encoding
+ * @param right Codepoint of the following character in UTF-32 encoding
+ *
+ * @return x kerning value
+ */
+float texture_font_get_kerning(texture_font_t *self, uint32_t left,
+                               uint32_t right);
+
 /**
  * Creates a new empty glyph
  *
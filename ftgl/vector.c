@@ -232,7 +232,9 @@ void vector_push_back_data(vector_t *self, const void *data, const size_t count)
 
     if (self->capacity < (self->size + count))
     {
-        vector_reserve(self, self->size + count);
+        vector_reserve(self, self->size + count > 2 * self->capacity
+                                 ? self->size + count
+                                 : 2 * self->capacity);
     }
     memmove((char *) (self->items) + self->size * self->item_size, data,
             count * self->item_size);
@@ -250,7 +252,9 @@ void vector_insert_data(vector_t *self, const size_t index, const void *data,
 
     if (self->capacity < (self->size + count))
     {
-        vector_reserve(self, self->size + count);
+        vector_reserve(self, self->size + count > 2 * self->capacity
+                                 ? self->size + count
+                                 : 2 * self->capacity);
     }
     memmove((char *) (self->items) + (index + count) * self->item_size,
             (char *) (self->items) + (index) *self->item_size,
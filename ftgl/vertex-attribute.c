@@ -135,6 +135,12 @@ void vertex_attribute_enable(vertex_attribute_t *attr)
         }
     }
     glEnableVertexAttribArray(attr->index);
+    if (attr->normalized)
+    {
+        glVertexAttribPointer(attr->index, attr->size, attr->type,
+                              attr->normalized, attr->stride, attr->pointer);
+        return;
+    }
     switch (attr->type)
     {
     case GL_UNSIGNED_SHORT:
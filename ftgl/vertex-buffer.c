@@ -467,6 +467,30 @@ void vertex_buffer_push_back_vertices(vertex_buffer_t *self,
     vector_push_back_data(self->vertices, vertices, vcount);
 }
 
+// ----------------------------------------------------------------------------
+void *vertex_buffer_alloc_vertices(vertex_buffer_t *self, const size_t vcount)
+{
+    vector_t *vertices = self->vertices;
+    size_t size        = vertices->size + vcount;
+    size_t capacity    = vertices->capacity;
+    void *result;
+
+    if (capacity < size)
+    {
+        while (capacity < size)
+        {
+            capacity *= 2;
+        }
+        vector_reserve(vertices, capacity);
+    }
+
+    result = (char *) vertices->items + vertices->size * vertices->item_size;
+
+    vertices->size = size;
+    self->state |= DIRTY;
+    return result;
+}
+
 // ----------------------------------------------------------------------------
 void vertex_buffer_insert_indices(vertex_buffer_t *self, const size_t index,
                                   const GLuint *indices, const size_t count)
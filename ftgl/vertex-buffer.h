@@ -169,6 +169,19 @@ void vertex_buffer_push_back_indices(vertex_buffer_t *self,
                                      const GLuint *indices,
                                      const size_t icount);
 
+/**
+ * Appends uninitialized vertices at the end of the buffer and returns them
+ * for the caller to fill in. No item is recorded and no index is touched,
+ * which makes this the cheap path for streaming geometry that is cleared
+ * and drawn whole every frame. Storage grows geometrically.
+ *
+ * @param  self     a vertex buffer
+ * @param  vcount   number of vertices to be appended
+ * @return          pointer to the first appended vertex, valid until the
+ *                  buffer is next modified
+ */
+void *vertex_buffer_alloc_vertices(vertex_buffer_t *self, const size_t vcount);
+
 /**
  * Appends vertices at the end of the buffer.
  *
@@ -37,11 +37,132 @@ typedef struct glez_vec4_s
 
 typedef unsigned int glez_texture_t;
 typedef unsigned int glez_font_t;
+typedef unsigned int glez_list_t;
+
+/* Initialization options */
+
+enum
+{
+    /* Copy the frame into a vertex buffer with glBufferData on every flush */
+    GLEZ_STREAMING_BUFFER_DATA = 0,
+    /* Write vertices into a triple-buffered ring. Persistently mapped when
+       ARB_buffer_storage is available, unsynchronized glMapBufferRange with
+       orphaning otherwise. Falls back to GLEZ_STREAMING_BUFFER_DATA without
+       glDrawElementsBaseVertex. */
+    GLEZ_STREAMING_RING
+};
+
+enum
+{
+    /* GLSL 1.30, any GL 3.0+ context */
+    GLEZ_PROFILE_COMPATIBILITY = 0,
+    /* GLSL 3.30 core, GL 3.3+ core profile contexts */
+    GLEZ_PROFILE_CORE,
+    /* GLSL ES 3.00, OpenGL ES 3.0+ contexts */
+    GLEZ_PROFILE_ES
+};
+
+enum
+{
+    /* glPushAttrib/glPushClientAttrib around the frame, compatibility
+       profile only: other profiles use GLEZ_STATE_SNAPSHOT instead */
+    GLEZ_STATE_PUSH_ATTRIB = 0,
+    /* Query at glez_begin and restore at glez_end only the state glez
+       changes */
+    GLEZ_STATE_SNAPSHOT,
+    /* Save nothing: the host sets up its own state after glez_end */
+    GLEZ_STATE_TRUST_HOST
+};
+
+enum
+{
+    /* One shader branching on the draw mode of each vertex: batches are
+       never split by mode */
+    GLEZ_SHADERS_UBER = 0,
+    /* Batches mixing modes use the ubershader, batches with a single mode
+       use a shader specialized for it */
+    GLEZ_SHADERS_AUTO,
+    /* Always specialized: a change of draw mode flushes the batch */
+    GLEZ_SHADERS_SPLIT
+};
+
+enum
+{
+    GLEZ_GPU_TIMING_OFF = 0,
+    /* One GL_TIME_ELAPSED query from glez_begin to glez_end. Fails if the
+       host has its own GL_TIME_ELAPSED query active at that point. */
+    GLEZ_GPU_TIMING_FRAME,
+    /* One query around each draw call, summed per frame */
+    GLEZ_GPU_TIMING_FLUSH
+};
+
+enum
+{
+    GLEZ_BACKEND_GL = 0,
+    /* Rasterize on the CPU into software_target. No GL context is needed
+       and no GL function is called. */
+    GLEZ_BACKEND_SOFTWARE
+};
+
+#define GLEZ_MAX_TEXTURE_SLOTS 8
+
+typedef struct glez_options_s
+{
+    /* Context glez renders into, GLEZ_PROFILE_* */
+    int profile;
+    int streaming;
+    /* Textures a single draw call may sample, 1 to GLEZ_MAX_TEXTURE_SLOTS.
+       The batch is flushed when a texture does not fit. 1 flushes on every
+       texture change. */
+    int texture_slots;
+    /* How the host GL state is preserved, GLEZ_STATE_* */
+    int state_guard;
+    /* Fragment shader selection, GLEZ_SHADERS_* */
+    int shader_variants;
+    /* Directory for linked program binaries, keyed by the GL vendor,
+       renderer, version and shader sources. NULL to always compile from
+       source. */
+    const char *binary_cache_dir;
+    /* GLEZ_GPU_TIMING_*, see glez_get_gpu_stats */
+    int gpu_timing;
+    /* GLEZ_BACKEND_* */
+    int backend;
+    /* GLEZ_BACKEND_SOFTWARE: RGBA8 pixels, top row first, stride bytes
+       apart. Can be changed later with glez_software_target. */
+    void *software_target;
+    int software_stride;
+    /* Threads sharing the rows of each batch, 0 for one per CPU */
+    int software_threads;
+    /* Memory kept for the glyph quads of strings drawn before, 0 to lay
+       out every string on every call */
+    unsigned layout_cache_bytes;
+    /* Threads rasterizing missing glyphs. Their strings are drawn without
+       them until the glyphs are placed in the atlas by a later glez_begin.
+       0 rasterizes on the calling thread, and the glyphs show up on the
+       next frame. */
+    int glyph_threads;
+    /* Bytes of rasterized glyphs placed in atlases per glez_begin, 0 for
+       no limit. At least one glyph is placed per frame. */
+    unsigned glyph_upload_budget;
+    /* Glyphs of all fonts and outline widths go to one set of atlas pages
+       instead of a set per font, so strings of different fonts share draw
+       calls */
+    int shared_atlas;
+    /* Width and height of glyph atlas pages, clamped to 64 and
+       GL_MAX_TEXTURE_SIZE. A page is added when the last one is full, up
+       to 16 per set. */
+    int atlas_page_size;
+} glez_options_t;
+
+/* Fills options with what glez_init uses */
+void glez_options_default(glez_options_t *options);
 
 /* State functions */
 
 void glez_init(int width, int height);
 
+void glez_init_ex(int width, int height, const glez_options_t *options);
+
 void glez_shutdown();
 
 void glez_begin();
@@ -50,6 +171,10 @@ void glez_end();
 
 void glez_resize(int width, int height);
 
+/* GLEZ_BACKEND_SOFTWARE: where the next batches are drawn, see
+   glez_options_t.software_target */
+void glez_software_target(void *pixels, int stride);
+
 /* Helper functions */
 
 static inline glez_rgba_t glez_rgba(unsigned char r, unsigned char g,
@@ -75,6 +200,47 @@ void glez_font_unload(glez_font_t handle);
 void glez_font_string_size(glez_font_t font, const char *string, float *out_x,
                            float *out_y);
 
+/* Unicode ranges for glez_font_preload, combined with | */
+#define GLEZ_RANGE_DIGITS (1u << 0)           /* 0-9 */
+#define GLEZ_RANGE_BASIC_LATIN (1u << 1)      /* U+0020 to U+007E */
+#define GLEZ_RANGE_LATIN1 (1u << 2)           /* U+00A0 to U+00FF */
+#define GLEZ_RANGE_LATIN_EXTENDED_A (1u << 3) /* U+0100 to U+017F */
+#define GLEZ_RANGE_GREEK (1u << 4)            /* U+0370 to U+03FF */
+#define GLEZ_RANGE_CYRILLIC (1u << 5)         /* U+0400 to U+04FF */
+#define GLEZ_RANGE_PUNCTUATION (1u << 6)      /* U+2010 to U+205E */
+
+/* Glyphs of glez_string, the default */
+#define GLEZ_PRELOAD_NORMAL (1u << 0)
+/* Outlines of glez_string_with_outline with the given outline_width */
+#define GLEZ_PRELOAD_OUTLINE (1u << 1)
+/* Queue the glyphs for the glyph threads instead of rasterizing them
+   before returning. Loads synchronously when glyph_threads is 0. */
+#define GLEZ_PRELOAD_ASYNC (1u << 2)
+
+typedef struct glez_preload_stats_s
+{
+    /* Glyphs rasterized, or queued with GLEZ_PRELOAD_ASYNC */
+    unsigned glyphs;
+    /* Glyphs already in the atlas */
+    unsigned cached;
+    /* Codepoints the font has no glyph for, skipped */
+    unsigned missing;
+    /* Set when the atlas pages ran out of space */
+    int atlas_full;
+    /* Wall time of glez_font_preload, in milliseconds */
+    double ms;
+    /* Fraction of the font's atlas pages in use on return. Asynchronous
+       loads keep filling them, see glez_frame_stats_t. */
+    float atlas_occupancy;
+} glez_preload_stats_t;
+
+/* Loads the glyphs of ranges (GLEZ_RANGE_*) in the variants of flags
+   (GLEZ_PRELOAD_*) so that their first use does not miss. Makes no GL
+   call: the atlas is uploaded at once when the font is next drawn. Returns
+   the number of glyphs loaded or queued. out may be NULL. */
+unsigned glez_font_preload(glez_font_t font, unsigned ranges, unsigned flags,
+                           float outline_width, glez_preload_stats_t *out);
+
 /* Texture-related functions */
 
 #define GLEZ_TEXTURE_COUNT 64
@@ -112,6 +278,134 @@ void glez_string_with_outline(float x, float y, const char *string,
 void glez_circle(float x, float y, float radius, glez_rgba_t color,
                  float thickness, int steps);
 
+/* Draw lists */
+
+#define GLEZ_LIST_COUNT 256
+#define GLEZ_LIST_INVALID ((glez_list_t) 0xFFFFFFFF)
+
+glez_list_t glez_list_new();
+
+void glez_list_free(glez_list_t list);
+
+/* Between glez_begin and glez_end: the drawing functions called until
+   glez_list_end are recorded into list, replacing what it held, instead of
+   being drawn. */
+void glez_list_begin(glez_list_t list);
+
+/* Uploads the recorded vertices to a static buffer */
+void glez_list_end();
+
+/* 0 once a font or texture the list was recorded with is unloaded. Such a
+   list is not drawn until it is recorded again. Also 0 while a capture
+   runs, until the list is recorded in a captured frame, so the capture
+   holds what the list draws. */
+int glez_list_valid(glez_list_t list);
+
+/* Draws list moved by dx, dy without generating any vertex, at the cost of
+   a draw call per texture switch of the recording */
+void glez_list_draw(glez_list_t list, float dx, float dy);
+
+/* Capture */
+
+/* Records every glez call of the next frames into path, for glez-replay.
+   frames is how many frames to record, 0 for all until glez_capture_stop.
+   Loaded fonts and textures are recorded by path: the files must still be
+   there when replaying. Lists are recorded as the calls that recorded
+   them, see glez_list_valid. Returns 0 on success. */
+int glez_capture_start(const char *path, int frames);
+
+void glez_capture_stop();
+
+/* Tracing */
+
+/* Starts keeping the last events trace events in memory, 0 for 65536:
+   glez_begin, glez_end, batch flushes with their reason, vertex and
+   atlas uploads, glyph rasterization and PNG decoding. Returns 0 on
+   success. */
+int glez_trace_start(unsigned events);
+
+/* Writes the events kept so far to path in the Chrome trace event JSON
+   format, for chrome://tracing or ui.perfetto.dev. Returns 0 on
+   success. */
+int glez_trace_write(const char *path);
+
+void glez_trace_stop();
+
+/* Statistics */
+
+/* All zero when built with GLEZ_NO_STATS */
+typedef struct glez_frame_stats_s
+{
+    unsigned long draw_calls;
+    /* Flushes forced by running out of texture slots */
+    unsigned long texture_flushes;
+    unsigned long vertices;
+    unsigned long indices;
+    /* Bytes of vertex data written for the GPU */
+    unsigned long vertex_upload_bytes;
+    /* Bytes of glyph atlas data sent to the GPU */
+    unsigned long atlas_upload_bytes;
+    /* Glyph lookups while drawing strings */
+    unsigned long glyph_hits;
+    unsigned long glyph_misses;
+    /* Glyphs rendered by FreeType into an atlas */
+    unsigned long glyphs_rasterized;
+    /* Glyphs waiting for a glyph thread or for the upload budget at the
+       end of the frame */
+    unsigned long glyphs_pending;
+    /* Strings drawn from the layout cache, and laid out again */
+    unsigned long layout_hits;
+    unsigned long layout_misses;
+    /* Size of the layout cache at the end of the frame */
+    unsigned long layout_cache_bytes;
+    /* Fraction of each font's atlas pages in use, indexed by glez_font_t.
+       Fonts sharing pages report the same value. */
+    float atlas_occupancy[GLEZ_FONT_COUNT];
+    /* Glyph atlas pages of all fonts */
+    unsigned long atlas_pages;
+    /* CPU time in milliseconds: glez_begin, from glez_begin to glez_end,
+       and glez_end */
+    double begin_ms;
+    double record_ms;
+    double end_ms;
+    /* Part of record_ms and end_ms spent flushing batches */
+    double flush_ms;
+} glez_frame_stats_t;
+
+/* Counters of the last frame completed by glez_end */
+void glez_get_frame_stats(glez_frame_stats_t *out);
+
+typedef struct glez_init_stats_s
+{
+    /* Wall time of glez_init, in milliseconds */
+    double total_ms;
+    /* Part of it spent building shader programs */
+    double programs_ms;
+    unsigned programs_compiled;
+    /* Loaded from binary_cache_dir */
+    unsigned programs_cached;
+} glez_init_stats_t;
+
+void glez_get_init_stats(glez_init_stats_t *out);
+
+#define GLEZ_GPU_TIMING_WINDOW 128
+
+/* GPU time of glez frames, read back a few frames late so the queries
+   never stall. Statistics cover the last GLEZ_GPU_TIMING_WINDOW frames
+   with a result. */
+typedef struct glez_gpu_stats_s
+{
+    double last_ms;
+    double min_ms;
+    double avg_ms;
+    double p99_ms;
+    unsigned samples;
+    /* Frames whose result was not ready in time */
+    unsigned long dropped;
+} glez_gpu_stats_t;
+
+void glez_get_gpu_stats(glez_gpu_stats_t *out);
+
 #ifdef __cplusplus
 }
 #endif
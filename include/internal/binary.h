@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+/* On-disk cache of linked program binaries, one file per key */
+
+#define BINARY_CACHE_FORMATS 8
+
+struct binary_cache_state
+{
+    int enabled;
+    char directory[256];
+    /* Hash of the GL vendor, renderer and version strings */
+    uint64_t context;
+    /* GL_PROGRAM_BINARY_FORMATS of the context, the first ones if it has
+       more */
+    GLenum formats[BINARY_CACHE_FORMATS];
+    int format_count;
+};
+
+extern struct binary_cache_state binary_cache;
+
+/* Disabled when directory is NULL or the context has no program binary
+   formats */
+void binary_cache_init(const char *directory);
+
+uint64_t binary_cache_hash(uint64_t hash, const char *string);
+
+/* Combines context with the hash of everything the program is built
+   from */
+uint64_t binary_cache_key(uint64_t sources);
+
+/* Returns 1 if program was loaded and links, 0 if it has to be built from
+   source */
+int binary_cache_load(GLuint program, uint64_t key);
+
+void binary_cache_store(GLuint program, uint64_t key);
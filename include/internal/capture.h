@@ -0,0 +1,189 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "glez.h"
+
+/* Capture file, read by tools/glez-replay.c. A capture_header, then
+   records of a 32-bit tag (op | payload size << 8) followed by the
+   payload. Payloads are the structs below, in host byte order, with any
+   string appended after them. */
+
+#define CAPTURE_MAGIC 0x435a4c47 /* "GLZC" */
+#define CAPTURE_VERSION 1
+/* Payload sizes fit in the 24 bits of the tag above the op */
+#define CAPTURE_RECORD_MAX (1u << 24)
+
+struct capture_header
+{
+    uint32_t magic;
+    uint32_t version;
+    /* Resolution when the capture started, see CAPTURE_OP_RESIZE */
+    int32_t width;
+    int32_t height;
+};
+
+enum
+{
+    /* capture_font + path */
+    CAPTURE_OP_FONT = 1,
+    /* capture_handle */
+    CAPTURE_OP_FONT_UNLOAD,
+    /* capture_handle + path */
+    CAPTURE_OP_TEXTURE,
+    /* capture_handle */
+    CAPTURE_OP_TEXTURE_UNLOAD,
+    /* capture_resize */
+    CAPTURE_OP_RESIZE,
+    /* No payload */
+    CAPTURE_OP_BEGIN,
+    CAPTURE_OP_END,
+    /* capture_line */
+    CAPTURE_OP_LINE,
+    /* capture_rect */
+    CAPTURE_OP_RECT,
+    /* capture_line, dx and dy being the size */
+    CAPTURE_OP_RECT_OUTLINE,
+    /* capture_rect_textured */
+    CAPTURE_OP_RECT_TEXTURED,
+    /* capture_string + string */
+    CAPTURE_OP_STRING,
+    /* capture_string_outline + string */
+    CAPTURE_OP_STRING_OUTLINE,
+    /* capture_circle */
+    CAPTURE_OP_CIRCLE,
+    /* capture_handle + string */
+    CAPTURE_OP_STRING_SIZE,
+    /* capture_font_preload */
+    CAPTURE_OP_FONT_PRELOAD,
+    /* capture_handle */
+    CAPTURE_OP_LIST_NEW,
+    CAPTURE_OP_LIST_FREE,
+    CAPTURE_OP_LIST_BEGIN,
+    /* No payload, the records since CAPTURE_OP_LIST_BEGIN are the list */
+    CAPTURE_OP_LIST_END,
+    /* capture_list_draw */
+    CAPTURE_OP_LIST_DRAW,
+    CAPTURE_OP_COUNT
+};
+
+struct capture_handle
+{
+    uint32_t handle;
+};
+
+struct capture_font
+{
+    uint32_t handle;
+    float size;
+};
+
+struct capture_font_preload
+{
+    uint32_t font;
+    uint32_t ranges;
+    uint32_t flags;
+    float outline_width;
+};
+
+struct capture_resize
+{
+    int32_t width;
+    int32_t height;
+};
+
+struct capture_line
+{
+    float x;
+    float y;
+    float dx;
+    float dy;
+    glez_rgba_t color;
+    float thickness;
+};
+
+struct capture_rect
+{
+    float x;
+    float y;
+    float w;
+    float h;
+    glez_rgba_t color;
+};
+
+struct capture_rect_textured
+{
+    float x;
+    float y;
+    float w;
+    float h;
+    glez_rgba_t color;
+    uint32_t texture;
+    float tx;
+    float ty;
+    float tw;
+    float th;
+};
+
+struct capture_string
+{
+    float x;
+    float y;
+    uint32_t font;
+    glez_rgba_t color;
+};
+
+struct capture_string_outline
+{
+    float x;
+    float y;
+    uint32_t font;
+    glez_rgba_t color;
+    glez_rgba_t outline_color;
+    float outline_width;
+    int32_t adjust_outline_alpha;
+};
+
+struct capture_list_draw
+{
+    uint32_t list;
+    float dx;
+    float dy;
+};
+
+struct capture_circle
+{
+    float x;
+    float y;
+    float radius;
+    glez_rgba_t color;
+    float thickness;
+    int32_t steps;
+};
+
+struct capture_state
+{
+    /* Open between glez_capture_start and the end of the last frame */
+    FILE *file;
+    /* Frames left to record, 0 for no limit */
+    int frames;
+    /* Between glez_begin and glez_end of a recorded frame */
+    int recording;
+    int width;
+    int height;
+};
+
+extern struct capture_state capture;
+
+/* Appends a record, string may be NULL. Stops the capture if the file
+   cannot be written. */
+void capture_write(int op, const void *payload, size_t size,
+                   const char *string);
+
+/* Called with every resolution change, captured or not */
+void capture_resize(int width, int height);
+
+void capture_begin_frame();
+
+void capture_end_frame();
@@ -11,12 +11,96 @@
 
 #include <vec234.h>
 
+/* Texture coordinates normalized to 0..65535 */
+struct vertex_texcoord
+{
+    unsigned short x;
+    unsigned short y;
+};
+
+/* Color normalized to 0..255 */
+struct vertex_color
+{
+    unsigned char r;
+    unsigned char g;
+    unsigned char b;
+    unsigned char a;
+};
+
+/* 20 bytes, matches "vertex:2f,tex_coord:2Sn,color:4Bn,drawmode:4B" */
 struct vertex_main
 {
     vec2 position;
-    vec2 tex_coords;
-    glez_rgba_t color;
-    int mode;
+    struct vertex_texcoord tex_coords;
+    struct vertex_color color;
+    unsigned char mode;
+    /* Texture unit sampled by textured modes, see ds_bind_texture */
+    unsigned char slot;
+    unsigned char reserved[2];
+};
+
+static inline unsigned short vertex_pack_texcoord(float value)
+{
+    if (value <= 0.0f)
+        return 0;
+    if (value >= 1.0f)
+        return 65535;
+    return (unsigned short) (value * 65535.0f + 0.5f);
+}
+
+static inline unsigned char vertex_pack_channel(float value)
+{
+    if (value <= 0.0f)
+        return 0;
+    if (value >= 1.0f)
+        return 255;
+    return (unsigned char) (value * 255.0f + 0.5f);
+}
+
+static inline struct vertex_color vertex_pack_color(glez_rgba_t color)
+{
+    struct vertex_color result;
+
+    result.r = vertex_pack_channel(color.r);
+    result.g = vertex_pack_channel(color.g);
+    result.b = vertex_pack_channel(color.b);
+    result.a = vertex_pack_channel(color.a);
+    return result;
+}
+
+/* Client-side copy of a texture, read by the software backend. depth is 1
+   for glyph atlases (GL_RED) and 4 for RGBA textures. */
+struct draw_image
+{
+    const unsigned char *pixels;
+    int width;
+    int height;
+    int depth;
+};
+
+/* Host state saved by GLEZ_STATE_SNAPSHOT */
+struct draw_host_state
+{
+    GLint program;
+    GLint vertex_array;
+    GLint array_buffer;
+    GLint unpack_buffer;
+    GLint active_texture;
+    GLint blend_src_rgb;
+    GLint blend_dst_rgb;
+    GLint blend_src_alpha;
+    GLint blend_dst_alpha;
+    GLboolean blend;
+    GLboolean cull_face;
+    GLboolean depth_test;
+    GLboolean stencil_test;
+    GLint unpack_alignment;
+    GLint unpack_row_length;
+    GLint unpack_skip_pixels;
+    GLint unpack_skip_rows;
+    /* Saved the first time glez binds to a unit, one bit per unit */
+    unsigned textures_saved;
+    GLint textures[GLEZ_MAX_TEXTURE_SLOTS];
 };
 
 struct draw_state
@@ -24,9 +108,18 @@ struct draw_state
     char dirty;
     GLuint texture;
     glez_font_t font;
+    /* Textures bound to units 0..slot_count-1 since the last flush */
+    GLuint slots[GLEZ_MAX_TEXTURE_SLOTS];
+    struct draw_image images[GLEZ_MAX_TEXTURE_SLOTS];
+    int slot_count;
+    int slot_limit;
+    /* Unit of ds.texture */
+    unsigned char slot;
+    int state_guard;
+    struct draw_host_state host;
 } ds;
 
-void ds_init();
+void ds_init(const glez_options_t *options);
 
 void ds_destroy();
 
@@ -34,4 +127,22 @@ void ds_pre_render();
 
 void ds_post_render();
 
-void ds_bind_texture(GLuint texture);
+/* Makes texture active and stores its unit in ds.slot. Flushes the batch
+   only when every slot is taken by another texture. The software backend
+   has no GL textures and tells them apart by image->pixels instead. */
+void ds_bind_texture(GLuint texture, const struct draw_image *image);
+
+/* Pixel unpack state of the host, see ds_unpack_begin */
+struct draw_unpack
+{
+    GLint alignment;
+    GLint row_length;
+    GLint skip_pixels;
+    GLint skip_rows;
+};
+
+/* Saves the unpack state into saved and sets tightly packed rows starting
+   at the first pixel, for uploads from client memory */
+void ds_unpack_begin(struct draw_unpack *saved);
+
+void ds_unpack_end(const struct draw_unpack *saved);
@@ -11,16 +11,64 @@
 
 #include "freetype-gl.h"
 
+#define INTERNAL_ATLAS_PAGES 16
+
+/* Atlas pages glyphs are placed in, each font having its own set unless
+   glez_options_t.shared_atlas is set. Glyphs never move: when the last
+   page is full, a new one is added. */
+typedef struct internal_atlas_set_s
+{
+    texture_atlas_t *pages[INTERNAL_ATLAS_PAGES];
+    unsigned count;
+    /* Fonts using the set */
+    unsigned users;
+} internal_atlas_set_t;
+
 typedef struct internal_font_s
 {
     int init;
 
     texture_font_t *font;
-    texture_atlas_t *atlas;
+    internal_atlas_set_t *atlases;
 } internal_font_t;
 
 texture_font_t *internal_font_get(glez_font_t handle);
 
-void internal_fonts_init();
+internal_atlas_set_t *internal_font_atlases(glez_font_t handle);
+
+void internal_font_upload_atlas(texture_atlas_t *atlas);
+
+/* Results of internal_font_commit_glyph */
+enum
+{
+    INTERNAL_GLYPH_ATLAS_FULL = 0,
+    INTERNAL_GLYPH_COMMITTED,
+    /* Larger than a page, smaller glyphs can still be placed */
+    INTERNAL_GLYPH_TOO_BIG
+};
+
+/* Places a rendered glyph in the last page of atlases, adding a page when
+   it is full. Returns an INTERNAL_GLYPH_*. */
+int internal_font_commit_glyph(texture_font_t *font,
+                               internal_atlas_set_t *atlases,
+                               const texture_glyph_bitmap_t *bitmap);
+
+/* Rasterizes codepoint in the font's current render mode, if it is not
+   loaded yet */
+int internal_font_load_glyph(texture_font_t *font,
+                             internal_atlas_set_t *atlases,
+                             uint32_t codepoint);
+
+/* Fraction of each loaded font's atlas pages in use, GLEZ_FONT_COUNT
+   entries. Fonts sharing pages report the same value. */
+void internal_fonts_occupancy(float *out);
+
+/* Atlas pages of all fonts */
+unsigned internal_fonts_pages();
+
+/* Records every loaded font into the capture file */
+void internal_fonts_capture();
+
+void internal_fonts_init(const glez_options_t *options);
 
 void internal_fonts_destroy();
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freetype-gl.h"
+
+/* Positioned glyph quads of strings drawn before, so that drawing the same
+   string again is a translated copy. Entries are evicted least recently
+   used first to stay within the byte budget. */
+
+/* One glyph, relative to the integer part of the string origin */
+struct layout_quad
+{
+    float x0;
+    float y0;
+    float x1;
+    float y1;
+    unsigned short s0;
+    unsigned short t0;
+    unsigned short s1;
+    unsigned short t1;
+    /* Atlas page of the font's internal_atlas_set_t */
+    unsigned short page;
+};
+
+/* What a layout depends on. The fractional part of the origin is part of
+   it since glyphs are snapped to whole pixels. */
+struct layout_key
+{
+    const texture_font_t *font;
+    int rendermode;
+    float outline_thickness;
+    float fraction_x;
+    float fraction_y;
+    const char *string;
+    size_t length;
+    uint64_t hash;
+};
+
+struct layout_entry
+{
+    /* Next entry of the same bucket */
+    struct layout_entry *next;
+    struct layout_entry *newer;
+    struct layout_entry *older;
+    struct layout_key key;
+    /* out_x and out_y of draw_string_internal */
+    float width;
+    float height;
+    size_t count;
+    size_t bytes;
+    /* Allocated with the entry, followed by the string */
+    struct layout_quad quads[];
+};
+
+struct layout_cache
+{
+    /* 0 disables the cache */
+    size_t budget;
+    size_t bytes;
+    size_t entries;
+    /* Power of two */
+    size_t bucket_count;
+    struct layout_entry **buckets;
+    struct layout_entry *newest;
+    struct layout_entry *oldest;
+    /* struct layout_quad of the string being laid out */
+    vector_t *scratch;
+};
+
+extern struct layout_cache layout;
+
+/* budget is in bytes, entries included */
+void layout_init(size_t budget);
+
+void layout_destroy();
+
+/* Fills in key->length and key->hash */
+void layout_key_hash(struct layout_key *key);
+
+/* NULL on a miss, otherwise marks the entry most recently used */
+const struct layout_entry *layout_find(const struct layout_key *key);
+
+/* Copies count quads into a new entry, evicting older ones as needed.
+   Layouts larger than the whole budget are not kept. */
+void layout_insert(const struct layout_key *key,
+                   const struct layout_quad *quads, size_t count,
+                   float width, float height);
+
+/* Drops the layouts of a font being unloaded */
+void layout_forget_font(const texture_font_t *font);
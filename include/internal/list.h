@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <vector.h>
+
+#include "glez.h"
+
+#include "internal/draw.h"
+
+/* Quads of a list drawn with one set of bound textures and one shader,
+   like a flushed batch */
+struct list_segment
+{
+    size_t first;
+    size_t quads;
+    /* program.batch_modes of the quads */
+    unsigned modes;
+    int slot_count;
+    GLuint slots[GLEZ_MAX_TEXTURE_SLOTS];
+    struct draw_image images[GLEZ_MAX_TEXTURE_SLOTS];
+};
+
+struct list_t
+{
+    int init;
+    /* struct vertex_main. Emptied by glez_list_end once uploaded to buffer,
+       the software backend draws from it instead. */
+    vector_t *vertices;
+    /* struct list_segment */
+    vector_t *segments;
+    size_t quads;
+    GLuint buffer;
+    /* Generation + 1 of every font and texture the list was recorded with,
+       0 for the ones it does not draw */
+    unsigned fonts[GLEZ_FONT_COUNT];
+    unsigned textures[GLEZ_TEXTURE_COUNT];
+    /* Recorded in a captured frame of the current capture */
+    int captured;
+};
+
+struct list_state
+{
+    struct list_t lists[GLEZ_LIST_COUNT];
+    /* Between glez_list_begin and glez_list_end */
+    struct list_t *recording;
+    /* Bumped when a handle is unloaded: its atlas or texture is gone, and
+       the handle may be reused by another file */
+    unsigned font_generations[GLEZ_FONT_COUNT];
+    unsigned texture_generations[GLEZ_TEXTURE_COUNT];
+};
+
+extern struct list_state lists;
+
+void lists_destroy();
+
+/* Writes the lists that exist when a capture starts */
+void lists_capture();
+
+/* program_push_quads while recording */
+struct vertex_main *list_push_quads(size_t count);
+
+/* program_draw while recording: ends the current segment with the bound
+   textures */
+void list_close_segment();
+
+/* Called by the drawing functions, no-ops unless recording */
+void list_use_font(glez_font_t font);
+
+void list_use_texture(glez_texture_t texture);
+
+void list_font_unloaded(glez_font_t font);
+
+void list_texture_unloaded(glez_texture_t texture);
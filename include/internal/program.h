@@ -2,28 +2,87 @@
 
 #include <vertex-buffer.h>
 
+#include "glez.h"
+
+#include "internal/draw.h"
+
 enum
 {
     DRAW_MODE_PLAIN = 1,
     DRAW_MODE_TEXTURED,
-    DRAW_MODE_FREETYPE
+    DRAW_MODE_FREETYPE,
+    DRAW_MODE_COUNT
 };
 
 struct program_t
 {
-    char shader_active;
-    unsigned shader;
+    /* Indexed by draw mode, 0 is the ubershader. Only the ones
+       options.shader_variants needs are built. */
+    unsigned shaders[DRAW_MODE_COUNT];
+    int variants;
+    /* Index of the shader in use this frame, -1 for none yet */
+    int active;
+    /* One bit per draw mode in the pending batch */
+    unsigned batch_modes;
     vertex_buffer_t *buffer;
+    /* Shared element buffer with the 0,1,2,2,3,0 pattern for quad_capacity
+       quads */
+    unsigned quad_indices;
+    size_t quad_capacity;
+    /* Attribute layout and quad_indices, pointing into vao_buffer */
+    unsigned vao;
+    unsigned vao_buffer;
+    /* Location of the model uniform and the translation it holds, per
+       shader. Only lists are drawn with a translation. */
+    int model_locations[DRAW_MODE_COUNT];
+    float offsets[DRAW_MODE_COUNT][2];
 };
 
 struct program_t program;
 
 void shader_screen_size(int width, int height);
 
-void program_init(int width, int height);
+void program_init(int width, int height, const glez_options_t *options);
+
+void program_destroy();
+
+/* Expects program.vao to be bound */
+void program_reserve_quads(size_t count);
+
+/* Makes the program and its vertex array current for a frame */
+void program_begin();
+
+void program_end();
 
-void program_draw();
+/* Why a batch is flushed, see program_draw */
+enum
+{
+    FLUSH_END_OF_FRAME,
+    /* A texture did not fit in the free slots */
+    FLUSH_TEXTURE_SLOTS,
+    /* GLEZ_SHADERS_SPLIT and a different draw mode */
+    FLUSH_DRAW_MODE,
+    /* The persistent stream segment is full */
+    FLUSH_BUFFER_FULL,
+    /* A draw list is recorded or drawn */
+    FLUSH_LIST,
+    FLUSH_REASON_COUNT
+};
+
+/* Draws the pending batch, reason is a FLUSH_* for tracing */
+void program_draw(int reason);
 
 void program_reset();
 
-unsigned program_next_index();
+struct list_t;
+
+/* Draws the segments of a recorded list from its buffer, moved by dx, dy.
+   Expects the pending batch to be flushed. */
+void program_draw_list(const struct list_t *list, float dx, float dy);
+
+/* Appends count quads (4 vertices each) drawn with mode to the frame and
+   returns them for the caller to fill in. The pointer is valid until the
+   next push or flush. With a persistent stream it points straight into
+   GPU-visible memory. Between glez_list_begin and glez_list_end the quads
+   go to the list instead. */
+struct vertex_main *program_push_quads(size_t count, int mode);
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "freetype-gl.h"
+
+#include "glez.h"
+
+#include "internal/fonts.h"
+
+/* Glyph rasterization off the render thread. A glyph missing while
+   drawing becomes a job; workers render jobs with their own FreeType
+   library and faces, and raster_commit places finished glyphs in the
+   atlases from glez_begin, within a byte budget per frame. */
+
+struct raster_job
+{
+    /* Queue order, then finished order */
+    struct raster_job *next;
+    /* Next job of the same pending bucket */
+    struct raster_job *bucket_next;
+    texture_font_t *font;
+    internal_atlas_set_t *atlases;
+    uint32_t codepoint;
+    rendermode_t rendermode;
+    float outline_thickness;
+    int rendered;
+    /* Exactly sized copy of the worker's buffer */
+    texture_glyph_bitmap_t bitmap;
+};
+
+/* FreeType face of a font opened by one worker */
+struct raster_face
+{
+    const texture_font_t *font;
+    FT_Face face;
+};
+
+struct raster_worker
+{
+    pthread_t thread;
+    FT_Library library;
+    /* struct raster_face */
+    vector_t *faces;
+    /* Job being rendered, NULL when idle */
+    struct raster_job *current;
+    /* Render target reused for every glyph */
+    texture_glyph_bitmap_t scratch;
+};
+
+#define RASTER_BUCKETS 256
+
+struct raster_state
+{
+    /* 0 rasterizes on the render thread as before */
+    int threads;
+    struct raster_worker *workers;
+    /* Bytes committed to atlases per glez_begin, 0 for no limit */
+    size_t budget;
+    pthread_mutex_t lock;
+    /* Signaled when a job is queued, and on shutdown */
+    pthread_cond_t start;
+    /* Signaled when a worker finishes a job */
+    pthread_cond_t idle;
+    int shutdown;
+    struct raster_job *queued;
+    struct raster_job *queued_tail;
+    struct raster_job *finished;
+    struct raster_job *finished_tail;
+    /* Every job not committed yet, queued, rendering or finished */
+    struct raster_job *pending[RASTER_BUCKETS];
+    size_t pending_count;
+};
+
+extern struct raster_state raster;
+
+void raster_init(const glez_options_t *options);
+
+void raster_destroy();
+
+/* Queues a glyph unless it is already pending. Returns 1 if queued. */
+int raster_request(texture_font_t *font, internal_atlas_set_t *atlases,
+                   uint32_t codepoint, rendermode_t rendermode,
+                   float outline_thickness);
+
+/* Commits finished glyphs, oldest first, until the budget is spent */
+void raster_commit();
+
+/* Cancels the jobs of a font being unloaded, waiting for the ones being
+   rendered, and closes the workers' faces of it */
+void raster_forget_font(const texture_font_t *font);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include "glez.h"
+#include "internal/draw.h"
+
+/* CPU rasterizer for GLEZ_BACKEND_SOFTWARE. Draws the same quads as the
+   GL path into a caller-provided RGBA8 buffer, following the fragment
+   shader and the glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA)
+   state. */
+
+struct software_state
+{
+    int enabled;
+    unsigned char *target;
+    int width;
+    int height;
+    int stride;
+
+    /* Each thread rasterizes a band of rows, thread 0 is the caller */
+    int threads;
+    pthread_t *workers;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned generation;
+    int pending;
+    int shutdown;
+
+    /* Batch being drawn */
+    const struct vertex_main *vertices;
+    size_t quads;
+    const struct draw_image *images;
+    /* Added to every position, see glez_list_draw */
+    vec2 offset;
+};
+
+extern struct software_state software;
+
+void software_init(int width, int height, const glez_options_t *options);
+
+void software_destroy();
+
+void software_resize(int width, int height);
+
+/* Rasterizes quads moved by dx, dy in order, sampling images by vertex
+   slot. Returns when the target is fully updated. */
+void software_draw(const struct vertex_main *vertices, size_t quads,
+                   const struct draw_image *images, float dx, float dy);
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "glez.h"
+
+struct stats_state
+{
+    /* Counters of the frame being recorded */
+    glez_frame_stats_t frame;
+    /* Counters of the last completed frame */
+    glez_frame_stats_t last;
+    glez_init_stats_t init;
+    /* When glez_begin returned */
+    double record_start;
+};
+
+extern struct stats_state stats;
+
+/* Frame counters compile to nothing with GLEZ_NO_STATS */
+#ifndef GLEZ_NO_STATS
+#define STATS_ADD(counter, value) (stats.frame.counter += (value))
+/* Declares a timer started now, STATS_ADD_MS adds the time since then */
+#define STATS_TIMER(name) double name = stats_now()
+#define STATS_ADD_MS(counter, timer)                                           \
+    STATS_ADD(counter, (stats_now() - (timer)) * 1000.0)
+#else
+#define STATS_ADD(counter, value) ((void) 0)
+#define STATS_TIMER(name) ((void) 0)
+#define STATS_ADD_MS(counter, timer) ((void) 0)
+#endif
+
+/* Monotonic clock in seconds */
+double stats_now();
+
+void stats_init();
+
+void stats_begin_frame();
+
+void stats_end_frame();
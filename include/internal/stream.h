@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <GL/glew.h>
+
+enum
+{
+    STREAM_NONE = 0,
+    /* Immutable storage mapped once, written in place */
+    STREAM_PERSISTENT,
+    /* Staged on the CPU, copied with unsynchronized glMapBufferRange */
+    STREAM_MAP_RANGE,
+    /* Staged on the CPU, the buffer is re-specified on every upload */
+    STREAM_BUFFER_DATA
+};
+
+/* The ring is split in one segment per frame in flight */
+#define STREAM_SEGMENTS 3
+
+struct stream_state
+{
+    int mode;
+    GLuint buffer;
+    /* Bytes per segment, a multiple of the quad size */
+    size_t segment_size;
+    /* Segment written by the current frame */
+    int segment;
+    GLsync fences[STREAM_SEGMENTS];
+    /* STREAM_PERSISTENT: base of the mapping, [start, end) of the current
+       segment is written but not drawn yet */
+    unsigned char *mapped;
+    size_t start;
+    size_t end;
+    /* STREAM_MAP_RANGE: next free byte of the whole buffer */
+    size_t offset;
+};
+
+extern struct stream_state stream;
+
+/* With ring set, picks STREAM_PERSISTENT or STREAM_MAP_RANGE from what the
+   context supports. Uses STREAM_BUFFER_DATA otherwise, or when there is
+   no glDrawElementsBaseVertex. */
+void stream_init(size_t segment_size, int ring);
+
+void stream_destroy();
+
+/* Waits until the GPU is done with the segment this frame will write */
+void stream_begin_frame();
+
+/* Fences the segment written by this frame */
+void stream_end_frame();
+
+/* STREAM_PERSISTENT */
+
+int stream_fits(size_t bytes);
+
+/* Replaces the ring with one whose segments hold at least bytes. Anything
+   written and not drawn yet is lost. */
+void stream_grow(size_t bytes);
+
+void *stream_alloc(size_t bytes);
+
+/* STREAM_MAP_RANGE and STREAM_BUFFER_DATA: copies bytes into the buffer,
+   which is left bound to GL_ARRAY_BUFFER, and returns their offset */
+size_t stream_upload(const void *data, size_t bytes);
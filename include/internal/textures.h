@@ -27,6 +27,9 @@ void internal_textures_init();
 
 void internal_textures_destroy();
 
+/* Records every loaded texture into the capture file */
+void internal_textures_capture();
+
 int internal_texture_load_png_rgba(const char *name, internal_texture_t *out);
 
 internal_texture_t *internal_texture_get(glez_texture_t handle);
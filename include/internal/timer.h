@@ -0,0 +1,47 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "glez.h"
+
+/* Frames a query may stay in flight before its result is read */
+#define TIMER_LATENCY 4
+
+struct timer_frame
+{
+    GLuint *queries;
+    int capacity;
+    /* Queries issued by the frame, their results add up to its GPU time */
+    int count;
+};
+
+struct timer_state
+{
+    int mode;
+    int frame;
+    struct timer_frame frames[TIMER_LATENCY];
+    /* Rolling window of frame times in milliseconds */
+    double samples[GLEZ_GPU_TIMING_WINDOW];
+    unsigned sample_count;
+    unsigned next_sample;
+    double last_ms;
+    unsigned long dropped;
+};
+
+extern struct timer_state timer;
+
+/* Leaves timing off if the context has no timer queries */
+void timer_init(const glez_options_t *options);
+
+void timer_destroy();
+
+/* Reads back the frame issued TIMER_LATENCY frames ago and starts a new
+   one */
+void timer_begin_frame();
+
+void timer_end_frame();
+
+/* Around each draw call with GLEZ_GPU_TIMING_FLUSH */
+void timer_begin_flush();
+
+void timer_end_flush();
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "glez.h"
+
+#include "internal/stats.h"
+
+#define TRACE_TEXT_SIZE 48
+
+/* One complete ("ph": "X") event of the Chrome trace format */
+struct trace_event
+{
+    /* Static strings */
+    const char *name;
+    const char *arg_name;
+    const char *text_name;
+    double start;
+    double duration;
+    long tid;
+    long arg;
+    char text[TRACE_TEXT_SIZE];
+};
+
+struct trace_state
+{
+    /* NULL when not tracing */
+    struct trace_event *events;
+    size_t capacity;
+    /* Events ever pushed, the ring holds the last capacity of them */
+    unsigned long total;
+    pthread_mutex_t lock;
+    /* trace_begin() of the current glez_begin */
+    double frame_start;
+};
+
+extern struct trace_state trace;
+
+/* Start time for trace_complete, 0 when not tracing */
+static inline double trace_begin()
+{
+    return trace.events ? stats_now() : 0.0;
+}
+
+/* Records an event from start to now. arg_name and text_name may be NULL
+   to leave out the argument. Safe to call from any thread. */
+void trace_complete(const char *name, double start, const char *arg_name,
+                    long arg, const char *text_name, const char *text);
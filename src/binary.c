@@ -0,0 +1,196 @@
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include "internal/binary.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BINARY_CACHE_MAGIC 0x425a4c47 /* "GLZB" */
+#define BINARY_CACHE_VERSION 1
+
+struct binary_cache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+    /* FNV-1a of the binary */
+    uint64_t checksum;
+};
+
+struct binary_cache_state binary_cache;
+
+static uint64_t binary_cache_hash_bytes(uint64_t hash, const void *data,
+                                        size_t length)
+{
+    const unsigned char *bytes = data;
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+uint64_t binary_cache_hash(uint64_t hash, const char *string)
+{
+    if (hash == 0)
+        hash = 0xcbf29ce484222325ull;
+    if (string == NULL)
+        string = "";
+    /* Keep the terminator so "ab" + "c" differs from "a" + "bc" */
+    return binary_cache_hash_bytes(hash, string, strlen(string) + 1);
+}
+
+uint64_t binary_cache_key(uint64_t sources)
+{
+    return binary_cache_hash_bytes(binary_cache.context, &sources,
+                                   sizeof(sources));
+}
+
+void binary_cache_init(const char *directory)
+{
+    GLint formats = 0;
+    GLint *list;
+
+    memset(&binary_cache, 0, sizeof(binary_cache));
+
+    if (directory == NULL)
+        return;
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+        return;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats == 0)
+        return;
+    list = malloc(formats * sizeof(GLint));
+    if (list == NULL)
+        return;
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, list);
+    for (GLint i = 0; i < formats && i < BINARY_CACHE_FORMATS; ++i)
+        binary_cache.formats[i] = list[i];
+    binary_cache.format_count =
+        formats < BINARY_CACHE_FORMATS ? formats : BINARY_CACHE_FORMATS;
+    free(list);
+
+    snprintf(binary_cache.directory, sizeof(binary_cache.directory), "%s",
+             directory);
+    binary_cache.context = binary_cache_hash(
+        0, (const char *) glGetString(GL_VENDOR));
+    binary_cache.context = binary_cache_hash(
+        binary_cache.context, (const char *) glGetString(GL_RENDERER));
+    binary_cache.context = binary_cache_hash(
+        binary_cache.context, (const char *) glGetString(GL_VERSION));
+    binary_cache.enabled = 1;
+}
+
+static int binary_cache_format_known(GLenum format)
+{
+    for (int i = 0; i < binary_cache.format_count; ++i)
+    {
+        if (binary_cache.formats[i] == format)
+            return 1;
+    }
+    return 0;
+}
+
+static void binary_cache_path(char *out, size_t size, uint64_t key,
+                              const char *suffix)
+{
+    snprintf(out, size, "%s/glez-%016llx.bin%s", binary_cache.directory,
+             (unsigned long long) key, suffix);
+}
+
+int binary_cache_load(GLuint program, uint64_t key)
+{
+    struct binary_cache_header header;
+    char path[320];
+    void *data;
+    FILE *file;
+    GLint status;
+
+    binary_cache_path(path, sizeof(path), key, "");
+    file = fopen(path, "rb");
+    if (file == NULL)
+        return 0;
+
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != BINARY_CACHE_MAGIC ||
+        header.version != BINARY_CACHE_VERSION || header.key != key ||
+        header.length == 0 || !binary_cache_format_known(header.format))
+    {
+        fclose(file);
+        return 0;
+    }
+
+    data = malloc(header.length);
+    if (data == NULL || fread(data, header.length, 1, file) != 1 ||
+        binary_cache_hash_bytes(0xcbf29ce484222325ull, data, header.length) !=
+            header.checksum)
+    {
+        free(data);
+        fclose(file);
+        return 0;
+    }
+    fclose(file);
+
+    /* A driver update that keeps the format but not the binary makes this
+       fail to link. An unknown format was turned away above, since it
+       would leave GL_INVALID_ENUM pending in the host's context. */
+    glProgramBinary(program, header.format, data, header.length);
+    free(data);
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    return status == GL_TRUE;
+}
+
+void binary_cache_store(GLuint program, uint64_t key)
+{
+    struct binary_cache_header header;
+    char path[320];
+    char temporary[340];
+    GLint length = 0;
+    GLenum format;
+    void *data;
+    FILE *file;
+    int written;
+
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    data = malloc(length);
+    if (data == NULL)
+        return;
+    glGetProgramBinary(program, length, &length, &format, data);
+
+    header.magic    = BINARY_CACHE_MAGIC;
+    header.version  = BINARY_CACHE_VERSION;
+    header.key      = key;
+    header.format   = format;
+    header.length   = length;
+    header.checksum = binary_cache_hash_bytes(0xcbf29ce484222325ull, data,
+                                              length);
+
+    /* Write to a private name first so a concurrent reader never sees a
+       partial file */
+    binary_cache_path(path, sizeof(path), key, "");
+    snprintf(temporary, sizeof(temporary), "%s.%d", path, (int) getpid());
+    file = fopen(temporary, "wb");
+    if (file == NULL)
+    {
+        free(data);
+        return;
+    }
+    written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(data, length, 1, file) == 1;
+    written = fclose(file) == 0 && written;
+    free(data);
+
+    if (written)
+        rename(temporary, path);
+    else
+        unlink(temporary);
+}
@@ -0,0 +1,98 @@
+#include "glez.h"
+
+#include "internal/capture.h"
+#include "internal/fonts.h"
+#include "internal/list.h"
+#include "internal/textures.h"
+
+#include <string.h>
+
+struct capture_state capture;
+
+void capture_write(int op, const void *payload, size_t size,
+                   const char *string)
+{
+    size_t length = string ? strlen(string) : 0;
+    uint32_t tag  = (uint32_t) op | (uint32_t) (size + length) << 8;
+
+    /* The tag holds 24 bits of payload size: a longer record could not be
+       read back, and dropping it would replay something else */
+    if (size + length >= CAPTURE_RECORD_MAX)
+    {
+        fprintf(stderr, "glez: capture record of %zu bytes is too large\n",
+                size + length);
+        glez_capture_stop();
+        return;
+    }
+    if (fwrite(&tag, sizeof(tag), 1, capture.file) != 1 ||
+        (size && fwrite(payload, size, 1, capture.file) != 1) ||
+        (length && fwrite(string, length, 1, capture.file) != 1))
+    {
+        perror("glez: capture write failed");
+        glez_capture_stop();
+    }
+}
+
+void capture_resize(int width, int height)
+{
+    struct capture_resize record = { width, height };
+
+    capture.width  = width;
+    capture.height = height;
+    if (capture.file)
+        capture_write(CAPTURE_OP_RESIZE, &record, sizeof(record), NULL);
+}
+
+void capture_begin_frame()
+{
+    if (capture.file == NULL || capture.recording)
+        return;
+    capture.recording = 1;
+    capture_write(CAPTURE_OP_BEGIN, NULL, 0, NULL);
+}
+
+void capture_end_frame()
+{
+    if (!capture.recording)
+        return;
+    capture_write(CAPTURE_OP_END, NULL, 0, NULL);
+    capture.recording = 0;
+    if (capture.frames && --capture.frames == 0)
+        glez_capture_stop();
+}
+
+int glez_capture_start(const char *path, int frames)
+{
+    struct capture_header header = { CAPTURE_MAGIC, CAPTURE_VERSION,
+                                     capture.width, capture.height };
+
+    glez_capture_stop();
+    capture.file = fopen(path, "wb");
+    if (capture.file == NULL)
+    {
+        perror("glez: could not open capture file");
+        return -1;
+    }
+    capture.frames = frames;
+    if (fwrite(&header, sizeof(header), 1, capture.file) != 1)
+    {
+        glez_capture_stop();
+        return -1;
+    }
+
+    /* Resources the recorded frames may refer to */
+    internal_fonts_capture();
+    internal_textures_capture();
+    if (capture.file)
+        lists_capture();
+    return capture.file ? 0 : -1;
+}
+
+void glez_capture_stop()
+{
+    if (capture.file == NULL)
+        return;
+    fclose(capture.file);
+    capture.file      = NULL;
+    capture.recording = 0;
+}
@@ -12,31 +12,37 @@
 
 #include "internal/draw.h"
 #include "internal/program.h"
+#include "internal/software.h"
+#include "internal/stats.h"
 
 #include <string.h>
 
-void ds_init()
+void ds_init(const glez_options_t *options)
 {
     memset(&ds, 0, sizeof(struct draw_state));
+    ds.slot_limit = options->texture_slots;
+    if (ds.slot_limit < 1)
+        ds.slot_limit = 1;
+    if (ds.slot_limit > GLEZ_MAX_TEXTURE_SLOTS)
+        ds.slot_limit = GLEZ_MAX_TEXTURE_SLOTS;
+    ds.state_guard = options->state_guard;
+    if (options->profile != GLEZ_PROFILE_COMPATIBILITY &&
+        ds.state_guard == GLEZ_STATE_PUSH_ATTRIB)
+        ds.state_guard = GLEZ_STATE_SNAPSHOT;
 }
 
 void ds_destroy()
 {
 }
 
-void ds_pre_render()
+static void ds_push_attrib()
 {
     glPushAttrib(GL_CURRENT_BIT | GL_ENABLE_BIT | GL_TEXTURE_BIT |
                  GL_COLOR_BUFFER_BIT);
 
-    glEnable(GL_BLEND);
     glEnable(GL_TEXTURE_2D);
     glDisable(GL_ALPHA_TEST);
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_DEPTH_TEST);
     glDisable(GL_LIGHTING);
-    glDisable(GL_STENCIL_TEST);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     glPushClientAttrib(GL_CLIENT_ALL_ATTRIB_BITS);
 
@@ -49,26 +55,197 @@ void ds_pre_render()
 
     glEnableClientState(GL_VERTEX_ARRAY);
     glEnableClientState(GL_INDEX_ARRAY);
+}
+
+static void ds_save_host_state()
+{
+    struct draw_host_state *host = &ds.host;
+
+    glGetIntegerv(GL_CURRENT_PROGRAM, &host->program);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &host->vertex_array);
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &host->array_buffer);
+    glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &host->unpack_buffer);
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &host->active_texture);
+    glGetIntegerv(GL_BLEND_SRC_RGB, &host->blend_src_rgb);
+    glGetIntegerv(GL_BLEND_DST_RGB, &host->blend_dst_rgb);
+    glGetIntegerv(GL_BLEND_SRC_ALPHA, &host->blend_src_alpha);
+    glGetIntegerv(GL_BLEND_DST_ALPHA, &host->blend_dst_alpha);
+    host->blend        = glIsEnabled(GL_BLEND);
+    host->cull_face    = glIsEnabled(GL_CULL_FACE);
+    host->depth_test   = glIsEnabled(GL_DEPTH_TEST);
+    host->stencil_test = glIsEnabled(GL_STENCIL_TEST);
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &host->unpack_alignment);
+    glGetIntegerv(GL_UNPACK_ROW_LENGTH, &host->unpack_row_length);
+    glGetIntegerv(GL_UNPACK_SKIP_PIXELS, &host->unpack_skip_pixels);
+    glGetIntegerv(GL_UNPACK_SKIP_ROWS, &host->unpack_skip_rows);
+    host->textures_saved = 0;
+
+    /* Glyph uploads read from client memory */
+    if (host->unpack_buffer)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+static void ds_set_capability(GLenum capability, GLboolean enabled)
+{
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+}
+
+static void ds_restore_host_state()
+{
+    struct draw_host_state *host = &ds.host;
+
+    for (int unit = 0; unit < GLEZ_MAX_TEXTURE_SLOTS; ++unit)
+    {
+        if (!(host->textures_saved & (1u << unit)))
+            continue;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, host->textures[unit]);
+    }
+    glActiveTexture(host->active_texture);
+
+    glUseProgram(host->program);
+    glBindVertexArray(host->vertex_array);
+    glBindBuffer(GL_ARRAY_BUFFER, host->array_buffer);
+    if (host->unpack_buffer)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, host->unpack_buffer);
+
+    glBlendFuncSeparate(host->blend_src_rgb, host->blend_dst_rgb,
+                        host->blend_src_alpha, host->blend_dst_alpha);
+    ds_set_capability(GL_BLEND, host->blend);
+    ds_set_capability(GL_CULL_FACE, host->cull_face);
+    ds_set_capability(GL_DEPTH_TEST, host->depth_test);
+    ds_set_capability(GL_STENCIL_TEST, host->stencil_test);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, host->unpack_alignment);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, host->unpack_row_length);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, host->unpack_skip_pixels);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, host->unpack_skip_rows);
+}
+
+void ds_pre_render()
+{
+    ds.texture    = 0;
+    ds.font       = 0;
+    ds.slot_count = 0;
+    ds.slot       = 0;
+
+    if (software.enabled)
+        return;
+
+    if (ds.state_guard == GLEZ_STATE_PUSH_ATTRIB)
+        ds_push_attrib();
+    else if (ds.state_guard == GLEZ_STATE_SNAPSHOT)
+        ds_save_host_state();
+
+    glEnable(GL_BLEND);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_STENCIL_TEST);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    ds.texture = 0;
-    ds.font    = 0;
+    program_begin();
 }
 
 void ds_post_render()
 {
-    program_draw();
+    program_draw(FLUSH_END_OF_FRAME);
     program_reset();
-    glPopClientAttrib();
-    glPopAttrib();
+    if (software.enabled)
+        return;
+
+    program_end();
+    if (ds.state_guard == GLEZ_STATE_PUSH_ATTRIB)
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glPopClientAttrib();
+        glPopAttrib();
+    }
+    else if (ds.state_guard == GLEZ_STATE_SNAPSHOT)
+        ds_restore_host_state();
+}
+
+static int ds_slot_holds(int slot, GLuint texture,
+                         const struct draw_image *image)
+{
+    if (software.enabled)
+        return ds.images[slot].pixels == image->pixels;
+    return ds.slots[slot] == texture;
+}
+
+static void ds_bind_unit(int slot, GLuint texture)
+{
+    glActiveTexture(GL_TEXTURE0 + slot);
+    if (ds.state_guard == GLEZ_STATE_SNAPSHOT &&
+        !(ds.host.textures_saved & (1u << slot)))
+    {
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &ds.host.textures[slot]);
+        ds.host.textures_saved |= 1u << slot;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
 }
 
-void ds_bind_texture(GLuint texture)
+void ds_bind_texture(GLuint texture, const struct draw_image *image)
 {
-    if (ds.texture != texture)
+    int slot;
+
+    if (ds.slot_count && ds_slot_holds(ds.slot, texture, image))
     {
-        program_draw();
-        program_reset();
-        ds.texture = texture;
-        glBindTexture(GL_TEXTURE_2D, texture);
+        ds.images[ds.slot] = *image;
+        return;
     }
+
+    for (slot = 0; slot < ds.slot_count; ++slot)
+    {
+        if (ds_slot_holds(slot, texture, image))
+            break;
+    }
+
+    if (slot == ds.slot_count)
+    {
+        if (ds.slot_count == ds.slot_limit)
+        {
+            program_draw(FLUSH_TEXTURE_SLOTS);
+            program_reset();
+            STATS_ADD(texture_flushes, 1);
+            ds.slot_count = 0;
+            slot          = 0;
+        }
+        ds.slots[slot]  = texture;
+        ds.images[slot] = *image;
+        ds.slot_count++;
+        if (!software.enabled)
+            ds_bind_unit(slot, texture);
+    }
+    else
+    {
+        ds.images[slot] = *image;
+        if (!software.enabled)
+            glActiveTexture(GL_TEXTURE0 + slot);
+    }
+
+    ds.texture = texture;
+    ds.slot    = slot;
+}
+
+void ds_unpack_begin(struct draw_unpack *saved)
+{
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &saved->alignment);
+    glGetIntegerv(GL_UNPACK_ROW_LENGTH, &saved->row_length);
+    glGetIntegerv(GL_UNPACK_SKIP_PIXELS, &saved->skip_pixels);
+    glGetIntegerv(GL_UNPACK_SKIP_ROWS, &saved->skip_rows);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+}
+
+void ds_unpack_end(const struct draw_unpack *saved)
+{
+    glPixelStorei(GL_UNPACK_ALIGNMENT, saved->alignment);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, saved->row_length);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, saved->skip_pixels);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, saved->skip_rows);
 }
@@ -6,7 +6,18 @@
  */
 
 #include "internal/fonts.h"
+#include "internal/capture.h"
+#include "internal/draw.h"
+#include "internal/list.h"
+#include "internal/layout.h"
+#include "internal/raster.h"
+#include "internal/software.h"
+#include "internal/stats.h"
+#include "internal/trace.h"
 
+#include <utf8-utils.h>
+
+#include <stdlib.h>
 #include <string.h>
 #include <memory.h>
 #include <stdio.h>
@@ -14,6 +25,18 @@
 
 internal_font_t loaded_fonts[GLEZ_FONT_COUNT];
 
+#define ATLAS_PAGE_MIN 64
+
+/* glez_options_t.shared_atlas and atlas_page_size */
+static int shared_atlas;
+static size_t atlas_page_size;
+/* Set of every font with shared_atlas, NULL while no font is loaded */
+static internal_atlas_set_t *shared_atlases;
+/* Whether internal_fonts_init holds a FreeType library reference */
+static int library_acquired;
+/* Render target of the glyphs rasterized on the render thread */
+static texture_glyph_bitmap_t glyph_scratch;
+
 texture_font_t *internal_font_get(glez_font_t handle)
 {
     assert(handle < GLEZ_FONT_COUNT);
@@ -22,9 +45,224 @@ texture_font_t *internal_font_get(glez_font_t handle)
     return loaded_fonts[handle].font;
 }
 
-void internal_fonts_init()
+internal_atlas_set_t *internal_font_atlases(glez_font_t handle)
+{
+    assert(handle < GLEZ_FONT_COUNT);
+    assert(loaded_fonts[handle].init);
+
+    return loaded_fonts[handle].atlases;
+}
+
+static texture_atlas_t *atlases_add_page(internal_atlas_set_t *atlases)
+{
+    texture_atlas_t *atlas;
+
+    if (atlases->count == INTERNAL_ATLAS_PAGES)
+        return NULL;
+    atlas = texture_atlas_new(atlas_page_size, atlas_page_size, 1);
+    if (atlas)
+        atlases->pages[atlases->count++] = atlas;
+    return atlas;
+}
+
+static internal_atlas_set_t *atlases_acquire()
+{
+    internal_atlas_set_t *atlases = shared_atlas ? shared_atlases : NULL;
+
+    if (atlases == NULL)
+    {
+        atlases = calloc(1, sizeof(*atlases));
+        if (atlases == NULL)
+            return NULL;
+        if (atlases_add_page(atlases) == NULL)
+        {
+            free(atlases);
+            return NULL;
+        }
+        if (shared_atlas)
+            shared_atlases = atlases;
+    }
+    atlases->users++;
+    return atlases;
+}
+
+static void atlases_release(internal_atlas_set_t *atlases)
+{
+    if (--atlases->users)
+        return;
+    for (unsigned i = 0; i < atlases->count; ++i)
+    {
+        if (atlases->pages[i]->id)
+            glDeleteTextures(1, &atlases->pages[i]->id);
+        texture_atlas_delete(atlases->pages[i]);
+    }
+    if (atlases == shared_atlases)
+        shared_atlases = NULL;
+    free(atlases);
+}
+
+int internal_font_commit_glyph(texture_font_t *font,
+                               internal_atlas_set_t *atlases,
+                               const texture_glyph_bitmap_t *bitmap)
+{
+    size_t page = atlases->count - 1;
+
+    /* A glyph that fits in no page must not add one */
+    if (bitmap->width + 2 > atlas_page_size ||
+        bitmap->height + 2 > atlas_page_size)
+        return INTERNAL_GLYPH_TOO_BIG;
+    if (texture_font_commit_glyph(font, atlases->pages[page], page, bitmap))
+        return INTERNAL_GLYPH_COMMITTED;
+    if (atlases_add_page(atlases) == NULL ||
+        !texture_font_commit_glyph(font, atlases->pages[page + 1], page + 1,
+                                   bitmap))
+        return INTERNAL_GLYPH_ATLAS_FULL;
+    return INTERNAL_GLYPH_COMMITTED;
+}
+
+int internal_font_load_glyph(texture_font_t *font,
+                             internal_atlas_set_t *atlases,
+                             uint32_t codepoint)
+{
+    if (texture_font_find_glyph_utf32(font, codepoint))
+        return 1;
+    return texture_font_render_glyph(font, font->library, font->face,
+                                     codepoint, font->rendermode,
+                                     font->outline_thickness,
+                                     &glyph_scratch) &&
+           internal_font_commit_glyph(font, atlases, &glyph_scratch) ==
+               INTERNAL_GLYPH_COMMITTED;
+}
+
+void internal_font_upload_atlas(texture_atlas_t *atlas)
+{
+    struct draw_image image = { atlas->data, atlas->width, atlas->height,
+                                atlas->depth };
+
+    if (software.enabled)
+    {
+        /* Sampled straight from atlas->data */
+        ds_bind_texture(0, &image);
+        if (atlas->dirty)
+            texture_atlas_reset_dirty(atlas);
+        return;
+    }
+
+    if (atlas->id == 0)
+    {
+        glGenTextures(1, &atlas->id);
+    }
+    ds_bind_texture(atlas->id, &image);
+    if (!atlas->dirty)
+        return;
+
+    double start = trace_begin();
+    struct draw_unpack unpack;
+    size_t bytes;
+
+    /* Rows of any width, whatever unpack state the host left */
+    ds_unpack_begin(&unpack);
+
+    if (atlas->texture_width != atlas->width ||
+        atlas->texture_height != atlas->height)
+    {
+        /* Storage is allocated once per atlas size, then only the dirty
+           region is sent */
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlas->width, atlas->height, 0,
+                     GL_RED, GL_UNSIGNED_BYTE, atlas->data);
+        atlas->texture_width  = atlas->width;
+        atlas->texture_height = atlas->height;
+        bytes                 = atlas->width * atlas->height * atlas->depth;
+    }
+    else
+    {
+        ivec4 region = atlas->dirty_region;
+
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, atlas->width);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, region.x);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, region.y);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, region.x, region.y, region.width,
+                        region.height, GL_RED, GL_UNSIGNED_BYTE, atlas->data);
+        bytes = region.width * region.height * atlas->depth;
+    }
+    ds_unpack_end(&unpack);
+    texture_atlas_reset_dirty(atlas);
+    STATS_ADD(atlas_upload_bytes, bytes);
+    trace_complete("atlas upload", start, "bytes", bytes, NULL, NULL);
+}
+
+static float atlases_occupancy(const internal_atlas_set_t *atlases)
 {
+    size_t used = 0;
+
+    for (unsigned i = 0; i < atlases->count; ++i)
+        used += atlases->pages[i]->used;
+    return (float) used / (atlases->count * atlas_page_size * atlas_page_size);
+}
+
+void internal_fonts_occupancy(float *out)
+{
+    for (glez_font_t i = 0; i < GLEZ_FONT_COUNT; ++i)
+    {
+        out[i] = 0;
+        if (loaded_fonts[i].init)
+            out[i] = atlases_occupancy(loaded_fonts[i].atlases);
+    }
+}
+
+unsigned internal_fonts_pages()
+{
+    unsigned pages = shared_atlases ? shared_atlases->count : 0;
+
+    for (glez_font_t i = 0; i < GLEZ_FONT_COUNT; ++i)
+    {
+        if (loaded_fonts[i].init && loaded_fonts[i].atlases != shared_atlases)
+            pages += loaded_fonts[i].atlases->count;
+    }
+    return pages;
+}
+
+void internal_fonts_capture()
+{
+    for (glez_font_t i = 0; i < GLEZ_FONT_COUNT; ++i)
+    {
+        texture_font_t *font = loaded_fonts[i].font;
+
+        if (!loaded_fonts[i].init)
+            continue;
+        struct capture_font record = { i, font->size };
+        capture_write(CAPTURE_OP_FONT, &record, sizeof(record),
+                      font->filename);
+    }
+}
+
+void internal_fonts_init(const glez_options_t *options)
+{
+    GLint page_size;
+    GLint max_size;
+
     memset(loaded_fonts, 0, sizeof(loaded_fonts));
+    shared_atlas = options->shared_atlas;
+    /* Pages smaller than a large glyph, or than the driver can hold, would
+       leave glyphs out */
+    page_size = options->atlas_page_size;
+    if (page_size < ATLAS_PAGE_MIN)
+        page_size = ATLAS_PAGE_MIN;
+    if (!software.enabled)
+    {
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+        if (page_size > max_size)
+            page_size = max_size;
+    }
+    atlas_page_size = page_size;
+    /* Keep one FreeType library alive for the whole glez instance, so
+       loading and unloading fonts never re-creates it. Without FreeType
+       every glez_font_load fails, and everything else still works. */
+    library_acquired = texture_font_library_acquire() != NULL;
 }
 
 void internal_fonts_destroy()
@@ -36,6 +274,11 @@ void internal_fonts_destroy()
             glez_font_unload(i);
         }
     }
+    if (library_acquired)
+        texture_font_library_release();
+    library_acquired = 0;
+    free(glyph_scratch.buffer);
+    memset(&glyph_scratch, 0, sizeof(glyph_scratch));
 }
 
 glez_font_t glez_font_load(const char *path, float size)
@@ -46,14 +289,15 @@ glez_font_t glez_font_load(const char *path, float size)
     internal_font_t result;
     memset(&result, 0, sizeof(result));
 
-    result.atlas = texture_atlas_new(1024, 1024, 1);
-    if (result.atlas == NULL)
+    result.atlases = atlases_acquire();
+    if (result.atlases == NULL)
         return GLEZ_FONT_INVALID;
 
-    result.font = texture_font_new_from_file(result.atlas, size, path);
+    result.font =
+        texture_font_new_from_file(result.atlases->pages[0], size, path);
     if (result.font == NULL)
     {
-        texture_atlas_delete(result.atlas);
+        atlases_release(result.atlases);
         return GLEZ_FONT_INVALID;
     }
 
@@ -63,10 +307,17 @@ glez_font_t glez_font_load(const char *path, float size)
         {
             result.init = 1;
             memcpy(&loaded_fonts[i], &result, sizeof(result));
+            if (capture.file)
+            {
+                struct capture_font record = { i, size };
+                capture_write(CAPTURE_OP_FONT, &record, sizeof(record), path);
+            }
             return i;
         }
     }
 
+    texture_font_delete(result.font);
+    atlases_release(result.atlases);
     return GLEZ_FONT_INVALID;
 }
 
@@ -75,10 +326,18 @@ void glez_font_unload(glez_font_t handle)
     assert(handle < GLEZ_FONT_COUNT);
     assert(loaded_fonts[handle].init);
 
-    texture_atlas_delete(loaded_fonts[handle].atlas);
+    raster_forget_font(loaded_fonts[handle].font);
+    layout_forget_font(loaded_fonts[handle].font);
     texture_font_delete(loaded_fonts[handle].font);
+    atlases_release(loaded_fonts[handle].atlases);
 
     loaded_fonts[handle].init = 0;
+    list_font_unloaded(handle);
+    if (capture.file)
+    {
+        struct capture_handle record = { handle };
+        capture_write(CAPTURE_OP_FONT_UNLOAD, &record, sizeof(record), NULL);
+    }
 }
 
 void glez_font_string_size(glez_font_t font, const char *string, float *out_x,
@@ -92,7 +351,21 @@ void glez_font_string_size(glez_font_t font, const char *string, float *out_x,
     texture_font_t *fnt = internal_font_get(font);
     if (fnt == NULL)
         return;
-    texture_font_load_glyphs(fnt, string);
+    /* Rasterizes glyphs, so replays need it too */
+    if (capture.file)
+    {
+        struct capture_handle record = { font };
+        capture_write(CAPTURE_OP_STRING_SIZE, &record, sizeof(record), string);
+    }
+    internal_atlas_set_t *atlases = internal_font_atlases(font);
+    size_t loaded                 = vector_size(fnt->glyphs);
+    double start                  = trace_begin();
+    for (size_t i = 0; string[i]; i += utf8_surrogate_len(&string[i]))
+        internal_font_load_glyph(fnt, atlases, utf8_to_utf32(&string[i]));
+    STATS_ADD(glyphs_rasterized, vector_size(fnt->glyphs) - loaded);
+    if (vector_size(fnt->glyphs) != loaded)
+        trace_complete("glyphs rasterize", start, "glyphs",
+                       vector_size(fnt->glyphs) - loaded, NULL, NULL);
 
     for (size_t i = 0; i < strlen(string); ++i)
     {
@@ -115,3 +388,100 @@ void glez_font_string_size(glez_font_t font, const char *string, float *out_x,
     if (out_y)
         *out_y = size_y;
 }
+
+/* Codepoints of each GLEZ_RANGE_* bit, in order */
+static const uint32_t preload_ranges[][2] = {
+    { 0x0030, 0x0039 }, { 0x0020, 0x007E }, { 0x00A0, 0x00FF },
+    { 0x0100, 0x017F }, { 0x0370, 0x03FF }, { 0x0400, 0x04FF },
+    { 0x2010, 0x205E },
+};
+
+#define PRELOAD_RANGE_COUNT (sizeof(preload_ranges) / sizeof(preload_ranges[0]))
+
+unsigned glez_font_preload(glez_font_t font, unsigned ranges, unsigned flags,
+                           float outline_width, glez_preload_stats_t *out)
+{
+    glez_preload_stats_t result = { 0 };
+    rendermode_t modes[2];
+    float thicknesses[2];
+    size_t variants = 0;
+    double start    = stats_now();
+    int committed;
+
+    texture_font_t *fnt           = internal_font_get(font);
+    internal_atlas_set_t *atlases = internal_font_atlases(font);
+    if (capture.file)
+    {
+        struct capture_font_preload record = { font, ranges, flags,
+                                               outline_width };
+        capture_write(CAPTURE_OP_FONT_PRELOAD, &record, sizeof(record), NULL);
+    }
+
+    if (flags & GLEZ_PRELOAD_NORMAL || !(flags & GLEZ_PRELOAD_OUTLINE))
+    {
+        modes[variants]         = RENDER_NORMAL;
+        thicknesses[variants++] = 0.0f;
+    }
+    if (flags & GLEZ_PRELOAD_OUTLINE)
+    {
+        modes[variants]         = RENDER_OUTLINE_POSITIVE;
+        thicknesses[variants++] = outline_width;
+    }
+    int async = (flags & GLEZ_PRELOAD_ASYNC) && raster.threads;
+
+    /* One scratch bitmap and the font's own face for every glyph; the
+       atlas pages are only marked dirty, and sent in one upload each when
+       drawn */
+    for (size_t r = 0; r < PRELOAD_RANGE_COUNT && !result.atlas_full; ++r)
+    {
+        if (!(ranges & (1u << r)))
+            continue;
+        for (uint32_t c = preload_ranges[r][0];
+             c <= preload_ranges[r][1] && !result.atlas_full; ++c)
+        {
+            if (FT_Get_Char_Index(fnt->face, c) == 0)
+            {
+                result.missing++;
+                continue;
+            }
+            for (size_t v = 0; v < variants; ++v)
+            {
+                if (texture_font_find_glyph_variant(fnt, c, modes[v],
+                                                    thicknesses[v]))
+                {
+                    result.cached++;
+                    continue;
+                }
+                if (async)
+                {
+                    result.glyphs += raster_request(fnt, atlases, c, modes[v],
+                                                    thicknesses[v]);
+                    continue;
+                }
+                if (!texture_font_render_glyph(fnt, fnt->library, fnt->face,
+                                               c, modes[v], thicknesses[v],
+                                               &glyph_scratch))
+                    continue;
+                committed =
+                    internal_font_commit_glyph(fnt, atlases, &glyph_scratch);
+                if (committed == INTERNAL_GLYPH_TOO_BIG)
+                    continue;
+                if (committed == INTERNAL_GLYPH_ATLAS_FULL)
+                {
+                    result.atlas_full = 1;
+                    break;
+                }
+                result.glyphs++;
+            }
+        }
+    }
+
+    if (!async)
+        STATS_ADD(glyphs_rasterized, result.glyphs);
+    result.ms              = (stats_now() - start) * 1000.0;
+    result.atlas_occupancy = atlases_occupancy(atlases);
+    trace_complete("font preload", start, "glyphs", result.glyphs, NULL, NULL);
+    if (out)
+        *out = result;
+    return result.glyphs;
+}
@@ -8,55 +8,147 @@
 #include "glez.h"
 
 #include "internal/program.h"
+#include "internal/capture.h"
 #include "internal/draw.h"
 #include "internal/fonts.h"
 #include "internal/textures.h"
+#include "internal/stats.h"
+#include "internal/stream.h"
+#include "internal/timer.h"
+#include "internal/trace.h"
+#include "internal/software.h"
+#include "internal/list.h"
+#include "internal/layout.h"
+#include "internal/raster.h"
+
+#include <utf8-utils.h>
 
 #include <math.h>
 
 /* State functions */
 
+void glez_options_default(glez_options_t *options)
+{
+    options->profile             = GLEZ_PROFILE_COMPATIBILITY;
+    options->streaming           = GLEZ_STREAMING_RING;
+    options->texture_slots       = GLEZ_MAX_TEXTURE_SLOTS;
+    options->state_guard         = GLEZ_STATE_SNAPSHOT;
+    options->shader_variants     = GLEZ_SHADERS_AUTO;
+    options->binary_cache_dir    = NULL;
+    options->gpu_timing          = GLEZ_GPU_TIMING_OFF;
+    options->backend             = GLEZ_BACKEND_GL;
+    options->software_target     = NULL;
+    options->software_stride     = 0;
+    options->software_threads    = 0;
+    options->layout_cache_bytes  = 1 << 20;
+    options->glyph_threads       = 1;
+    options->glyph_upload_budget = 64 << 10;
+    options->shared_atlas        = 0;
+    options->atlas_page_size     = 1024;
+}
+
 void glez_init(int width, int height)
 {
-    ds_init();
-    program_init(width, height);
-    internal_fonts_init();
+    glez_options_t options;
+
+    glez_options_default(&options);
+    glez_init_ex(width, height, &options);
+}
+
+void glez_init_ex(int width, int height, const glez_options_t *options)
+{
+    double start = stats_now();
+
+    if (options->backend == GLEZ_BACKEND_SOFTWARE)
+        software_init(width, height, options);
+    ds_init(options);
+    stats_init();
+    program_init(width, height, options);
+    if (!software.enabled)
+        timer_init(options);
+    internal_fonts_init(options);
     internal_textures_init();
+    layout_init(options->layout_cache_bytes);
+    raster_init(options);
+    capture_resize(width, height);
+    stats.init.total_ms = (stats_now() - start) * 1000.0;
 }
 
 void glez_shutdown()
 {
+    glez_capture_stop();
+    lists_destroy();
     ds_destroy();
+    stream_destroy();
+    program_destroy();
+    timer_destroy();
+    software_destroy();
+    raster_destroy();
     internal_fonts_destroy();
     internal_textures_destroy();
+    layout_destroy();
 }
 
 void glez_begin()
 {
+    STATS_TIMER(start);
+    double trace_start = trace_begin();
+
+    capture_begin_frame();
+    stats_begin_frame();
+    stream_begin_frame();
     ds_pre_render();
+    raster_commit();
+    timer_begin_frame();
+    STATS_ADD_MS(begin_ms, start);
+    trace_complete("glez_begin", trace_start, NULL, 0, NULL, NULL);
+    trace.frame_start = trace_start;
+#ifndef GLEZ_NO_STATS
+    stats.record_start = stats_now();
+#endif
 }
 
 void glez_end()
 {
+    STATS_TIMER(start);
+    double trace_start = trace_begin();
+
+    STATS_ADD_MS(record_ms, stats.record_start);
     ds_post_render();
+    timer_end_frame();
+    stream_end_frame();
+#ifndef GLEZ_NO_STATS
+    internal_fonts_occupancy(stats.frame.atlas_occupancy);
+    stats.frame.layout_cache_bytes = layout.bytes;
+    stats.frame.glyphs_pending     = raster.pending_count;
+    stats.frame.atlas_pages        = internal_fonts_pages();
+#endif
+    STATS_ADD_MS(end_ms, start);
+    stats_end_frame();
+    capture_end_frame();
+    trace_complete("glez_end", trace_start, NULL, 0, NULL, NULL);
+    trace_complete("frame", trace.frame_start, NULL, 0, NULL, NULL);
 }
 
 void glez_resize(int width, int height)
 {
-    shader_screen_size(width, height);
+    capture_resize(width, height);
+    if (software.enabled)
+        software_resize(width, height);
+    else
+        shader_screen_size(width, height);
 }
 
 /* Drawing functions */
 
-void glez_line(float x, float y, float dx, float dy, glez_rgba_t color,
-               float thickness)
+static void draw_line_internal(float x, float y, float dx, float dy,
+                               glez_rgba_t color, float thickness)
 {
     /*x += 0.375f;
     y += 0.375f;*/
 
-    GLuint indices[6] = { 0, 1, 3, 3, 2, 0 };
-
-    struct vertex_main vertices[4];
+    struct vertex_main *vertices;
+    struct vertex_color rgba = vertex_pack_color(color);
 
     float nx = -dy;
     float ny = dx;
@@ -73,215 +165,370 @@ void glez_line(float x, float y, float dx, float dy, glez_rgba_t color,
     nx /= length;
     ny /= length;
 
+    vertices = program_push_quads(1, DRAW_MODE_PLAIN);
+
     vertices[0].position.x = x - nx;
     vertices[0].position.y = y - ny;
-    vertices[0].color      = color;
+    vertices[0].color      = rgba;
     vertices[0].mode       = DRAW_MODE_PLAIN;
 
     vertices[1].position.x = x + nx;
     vertices[1].position.y = y + ny;
-    vertices[1].color      = color;
+    vertices[1].color      = rgba;
     vertices[1].mode       = DRAW_MODE_PLAIN;
 
-    vertices[2].position.x = ex - nx;
-    vertices[2].position.y = ey - ny;
-    vertices[2].color      = color;
+    vertices[2].position.x = ex + nx;
+    vertices[2].position.y = ey + ny;
+    vertices[2].color      = rgba;
     vertices[2].mode       = DRAW_MODE_PLAIN;
 
-    vertices[3].position.x = ex + nx;
-    vertices[3].position.y = ey + ny;
-    vertices[3].color      = color;
+    vertices[3].position.x = ex - nx;
+    vertices[3].position.y = ey - ny;
+    vertices[3].color      = rgba;
     vertices[3].mode       = DRAW_MODE_PLAIN;
+}
 
-    vertex_buffer_push_back(program.buffer, vertices, 4, indices, 6);
+void glez_line(float x, float y, float dx, float dy, glez_rgba_t color,
+               float thickness)
+{
+    if (capture.recording)
+    {
+        struct capture_line record = { x, y, dx, dy, color, thickness };
+        capture_write(CAPTURE_OP_LINE, &record, sizeof(record), NULL);
+    }
+    draw_line_internal(x, y, dx, dy, color, thickness);
 }
 
 void glez_rect(float x, float y, float w, float h, glez_rgba_t color)
 {
+    if (capture.recording)
+    {
+        struct capture_rect record = { x, y, w, h, color };
+        capture_write(CAPTURE_OP_RECT, &record, sizeof(record), NULL);
+    }
+
     /*x += 0.375f;
     y += 0.375f;*/
 
-    struct vertex_main vertices[4];
-    GLuint indices[6] = { 0, 1, 2, 2, 3, 0 };
+    struct vertex_main *vertices = program_push_quads(1, DRAW_MODE_PLAIN);
+    struct vertex_color rgba     = vertex_pack_color(color);
 
     vertices[0].position.x = x;
     vertices[0].position.y = y;
-    vertices[0].color      = color;
+    vertices[0].color      = rgba;
     vertices[0].mode       = DRAW_MODE_PLAIN;
 
     vertices[1].position.x = x;
     vertices[1].position.y = y + h;
-    vertices[1].color      = color;
+    vertices[1].color      = rgba;
     vertices[1].mode       = DRAW_MODE_PLAIN;
 
     vertices[2].position.x = x + w;
     vertices[2].position.y = y + h;
-    vertices[2].color      = color;
+    vertices[2].color      = rgba;
     vertices[2].mode       = DRAW_MODE_PLAIN;
 
     vertices[3].position.x = x + w;
     vertices[3].position.y = y;
-    vertices[3].color      = color;
+    vertices[3].color      = rgba;
     vertices[3].mode       = DRAW_MODE_PLAIN;
-
-    vertex_buffer_push_back(program.buffer, vertices, 4, indices, 6);
 }
 
 void glez_rect_outline(float x, float y, float w, float h, glez_rgba_t color,
                        float thickness)
 {
-    glez_line(x, y, w, 0, color, thickness);
-    glez_line(x + w, y, 0, h, color, thickness);
-    glez_line(x + w, y + h, -w, 0, color, thickness);
-    glez_line(x, y + h, 0, -h, color, thickness);
+    if (capture.recording)
+    {
+        struct capture_line record = { x, y, w, h, color, thickness };
+        capture_write(CAPTURE_OP_RECT_OUTLINE, &record, sizeof(record), NULL);
+    }
+
+    draw_line_internal(x, y, w, 0, color, thickness);
+    draw_line_internal(x + w, y, 0, h, color, thickness);
+    draw_line_internal(x + w, y + h, -w, 0, color, thickness);
+    draw_line_internal(x, y + h, 0, -h, color, thickness);
 }
 
 void glez_rect_textured(float x, float y, float w, float h, glez_rgba_t color,
                         glez_texture_t texture, float tx, float ty, float tw,
                         float th)
 {
+    if (capture.recording)
+    {
+        struct capture_rect_textured record = {
+            x, y, w, h, color, texture, tx, ty, tw, th
+        };
+        capture_write(CAPTURE_OP_RECT_TEXTURED, &record, sizeof(record),
+                      NULL);
+    }
+
     internal_texture_t *tex = internal_texture_get(texture);
     internal_texture_bind(texture);
+    list_use_texture(texture);
 
     /*x += 0.375f;
     y += 0.375f;*/
 
-    GLuint idx = program_next_index();
-
-    struct vertex_main vertices[4];
-    GLuint indices[6] = { idx, idx + 1, idx + 2, idx + 2, idx + 3, idx };
+    struct vertex_main *vertices = program_push_quads(1, DRAW_MODE_TEXTURED);
+    struct vertex_color rgba     = vertex_pack_color(color);
 
-    float s0 = tx / tex->width;
-    float s1 = (tx + tw) / tex->width;
-    float t0 = ty / tex->height;
-    float t1 = (ty + th) / tex->height;
+    unsigned short s0 = vertex_pack_texcoord(tx / tex->width);
+    unsigned short s1 = vertex_pack_texcoord((tx + tw) / tex->width);
+    unsigned short t0 = vertex_pack_texcoord(ty / tex->height);
+    unsigned short t1 = vertex_pack_texcoord((ty + th) / tex->height);
 
     vertices[0].position.x   = x;
     vertices[0].position.y   = y;
     vertices[0].tex_coords.x = s0;
     vertices[0].tex_coords.y = t1;
-    vertices[0].color        = color;
+    vertices[0].color        = rgba;
     vertices[0].mode         = DRAW_MODE_TEXTURED;
+    vertices[0].slot         = ds.slot;
 
     vertices[1].position.x   = x;
     vertices[1].position.y   = y + h;
     vertices[1].tex_coords.x = s0;
     vertices[1].tex_coords.y = t0;
-    vertices[1].color        = color;
+    vertices[1].color        = rgba;
     vertices[1].mode         = DRAW_MODE_TEXTURED;
+    vertices[1].slot         = ds.slot;
 
     vertices[2].position.x   = x + w;
     vertices[2].position.y   = y + h;
     vertices[2].tex_coords.x = s1;
     vertices[2].tex_coords.y = t0;
-    vertices[2].color        = color;
+    vertices[2].color        = rgba;
     vertices[2].mode         = DRAW_MODE_TEXTURED;
+    vertices[2].slot         = ds.slot;
 
     vertices[3].position.x   = x + w;
     vertices[3].position.y   = y;
     vertices[3].tex_coords.x = s1;
     vertices[3].tex_coords.y = t1;
-    vertices[3].color        = color;
+    vertices[3].color        = rgba;
     vertices[3].mode         = DRAW_MODE_TEXTURED;
-
-    vertex_buffer_push_back(program.buffer, vertices, 4, indices, 6);
+    vertices[3].slot         = ds.slot;
 }
 
-/* INTERNAL FUNCTION */
-void draw_string_internal(float x, float y, const char *string,
-                          texture_font_t *fnt, glez_vec4_t color, float *out_x,
-                          float *out_y)
+/* Lays out string with its origin at (fraction_x, fraction_y) into
+   layout.scratch. Returns 0 when a glyph was missing: it is left out and
+   rasterized, on a glyph thread or right away, for a later frame. */
+static int draw_string_layout(texture_font_t *fnt,
+                              internal_atlas_set_t *atlases,
+                              const char *string, float fraction_x,
+                              float fraction_y, float *width, float *height)
 {
-    float pen_x  = x;
-    float pen_y  = y + fnt->height / 1.5f;
-    float size_y = 0;
-
-    if (fnt->atlas->id == 0)
-    {
-        glGenTextures(1, &fnt->atlas->id);
-    }
-    ds_bind_texture(fnt->atlas->id);
-    if (fnt->atlas->dirty)
-    {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, fnt->atlas->width,
-                     fnt->atlas->height, 0, GL_RED, GL_UNSIGNED_BYTE,
-                     fnt->atlas->data);
-        fnt->atlas->dirty = 0;
-    }
-
-    int len = strlen(string);
-    if (len == 0)
-        return;
-
-    for (size_t i = 0; i < len; ++i)
+    float pen_x     = fraction_x;
+    float pen_y     = fraction_y + fnt->height / 1.5f;
+    float kerning_x = fraction_x;
+    float size_y    = 0;
+    int complete    = 1;
+    size_t previous = 0;
+    size_t count    = 0;
+
+    /* At most one quad per byte */
+    vector_reserve(layout.scratch, strlen(string));
+    struct layout_quad *quads = layout.scratch->items;
+    for (size_t i = 0; string[i]; i += utf8_surrogate_len(&string[i]))
     {
         texture_glyph_t *glyph = texture_font_find_glyph(fnt, &string[i]);
         if (glyph == NULL)
         {
-            texture_font_load_glyph(fnt, &string[i]);
-            continue;
+            uint32_t codepoint = utf8_to_utf32(&string[i]);
+
+            STATS_ADD(glyph_misses, 1);
+            /* A list is recorded once, it cannot wait for the glyph */
+            if (raster.threads && !lists.recording)
+            {
+                raster_request(fnt, atlases, codepoint, fnt->rendermode,
+                               fnt->outline_thickness);
+                complete = 0;
+                continue;
+            }
+            double start = trace_begin();
+            if (internal_font_load_glyph(fnt, atlases, codepoint))
+            {
+                STATS_ADD(glyphs_rasterized, 1);
+                trace_complete("glyph rasterize", start, "codepoint",
+                               utf8_to_utf32(&string[i]), NULL, NULL);
+            }
+            /* The atlas is uploaded by the next frame, or by glez_list_end
+               before a list can be drawn */
+            if (!lists.recording ||
+                (glyph = texture_font_find_glyph(fnt, &string[i])) == NULL)
+            {
+                complete = 0;
+                continue;
+            }
         }
-        GLuint indices[6];
-        struct vertex_main vertices[4];
+        else
+            STATS_ADD(glyph_hits, 1);
         if (i > 0)
         {
-            x += texture_glyph_get_kerning(glyph, &string[i - 1]);
+            kerning_x += texture_glyph_get_kerning(glyph, &string[previous]);
         }
-
-        float x0 = (int)(pen_x + glyph->offset_x);
-        float y0 = (int)(pen_y - glyph->offset_y);
-        float x1 = (int)(x0 + glyph->width);
-        float y1 = (int)(y0 + glyph->height);
-        float s0 = glyph->s0;
-        float t0 = glyph->t0;
-        float s1 = glyph->s1;
-        float t1 = glyph->t1;
-
-        indices[0] = 0;
-        indices[1] = 1;
-        indices[2] = 2;
-        indices[3] = 2;
-        indices[4] = 3;
-        indices[5] = 0;
-
-        vertices[0] = (struct vertex_main){ (vec2){ x0, y0 }, (vec2){ s0, t0 },
-                                            color, DRAW_MODE_FREETYPE };
-        vertices[1] = (struct vertex_main){ (vec2){ x0, y1 }, (vec2){ s0, t1 },
-                                            color, DRAW_MODE_FREETYPE };
-        vertices[2] = (struct vertex_main){ (vec2){ x1, y1 }, (vec2){ s1, t1 },
-                                            color, DRAW_MODE_FREETYPE };
-        vertices[3] = (struct vertex_main){ (vec2){ x1, y0 }, (vec2){ s1, t0 },
-                                            color, DRAW_MODE_FREETYPE };
+        previous = i;
+
+        struct layout_quad *quad = &quads[count++];
+        quad->x0 = floorf(pen_x + glyph->offset_x);
+        quad->y0 = floorf(pen_y - glyph->offset_y);
+        quad->x1 = quad->x0 + glyph->width;
+        quad->y1 = quad->y0 + glyph->height;
+        quad->s0 = vertex_pack_texcoord(glyph->s0);
+        quad->t0 = vertex_pack_texcoord(glyph->t0);
+        quad->s1 = vertex_pack_texcoord(glyph->s1);
+        quad->t1 = vertex_pack_texcoord(glyph->t1);
+        quad->page = glyph->page;
 
         pen_x += glyph->advance_x;
         //pen_x = (int) pen_x + 1;
         if (glyph->height > size_y)
             size_y = glyph->height;
+    }
+
+    layout.scratch->size = count;
+    *width               = pen_x - kerning_x;
+    *height              = size_y;
+    return complete;
+}
+
+/* Pushes the quads of a layout on one atlas page moved by x, y, which are
+   whole pixels */
+static void draw_layout_page(const struct layout_quad *quads, size_t count,
+                             size_t page_quads, unsigned short page, float x,
+                             float y, struct vertex_color rgba)
+{
+    struct vertex_main *vertices;
+    unsigned char slot = ds.slot;
+
+    vertices = program_push_quads(page_quads, DRAW_MODE_FREETYPE);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (quads[i].page != page)
+            continue;
+
+        float x0 = x + quads[i].x0;
+        float y0 = y + quads[i].y0;
+        float x1 = x + quads[i].x1;
+        float y1 = y + quads[i].y1;
+        unsigned short s0 = quads[i].s0;
+        unsigned short t0 = quads[i].t0;
+        unsigned short s1 = quads[i].s1;
+        unsigned short t1 = quads[i].t1;
+
+        vertices[0] = (struct vertex_main){ { { x0, y0 } }, { s0, t0 }, rgba,
+                                            DRAW_MODE_FREETYPE, slot };
+        vertices[1] = (struct vertex_main){ { { x0, y1 } }, { s0, t1 }, rgba,
+                                            DRAW_MODE_FREETYPE, slot };
+        vertices[2] = (struct vertex_main){ { { x1, y1 } }, { s1, t1 }, rgba,
+                                            DRAW_MODE_FREETYPE, slot };
+        vertices[3] = (struct vertex_main){ { { x1, y0 } }, { s1, t0 }, rgba,
+                                            DRAW_MODE_FREETYPE, slot };
+        vertices += 4;
+    }
+}
 
-        vertex_buffer_push_back(program.buffer, vertices, 4, indices, 6);
+/* Binds the atlas pages of a layout and pushes its quads, page by page */
+static void draw_layout(const struct layout_quad *quads, size_t count,
+                        float x, float y, struct vertex_color rgba,
+                        const internal_atlas_set_t *atlases)
+{
+    if (atlases->count == 1)
+    {
+        internal_font_upload_atlas(atlases->pages[0]);
+        if (count)
+            draw_layout_page(quads, count, count, 0, x, y, rgba);
+        return;
+    }
+
+    for (unsigned short page = 0; page < atlases->count; ++page)
+    {
+        size_t page_quads = 0;
+
+        for (size_t i = 0; i < count; ++i)
+            page_quads += quads[i].page == page;
+        if (page_quads == 0)
+            continue;
+        internal_font_upload_atlas(atlases->pages[page]);
+        draw_layout_page(quads, count, page_quads, page, x, y, rgba);
+    }
+}
+
+/* INTERNAL FUNCTION */
+void draw_string_internal(float x, float y, const char *string,
+                          texture_font_t *fnt, internal_atlas_set_t *atlases,
+                          glez_vec4_t color, float *out_x, float *out_y)
+{
+    const struct layout_entry *entry = NULL;
+    struct layout_key key;
+    float origin_x = floorf(x);
+    float origin_y = floorf(y);
+    float width;
+    float height;
+
+    struct vertex_color rgba = vertex_pack_color(color);
+
+    key.font              = fnt;
+    key.rendermode        = fnt->rendermode;
+    key.outline_thickness = fnt->outline_thickness;
+    key.fraction_x        = x - origin_x;
+    key.fraction_y        = y - origin_y;
+    key.string            = string;
+    if (layout.budget)
+    {
+        layout_key_hash(&key);
+        entry = layout_find(&key);
+    }
+
+    if (entry)
+    {
+        STATS_ADD(layout_hits, 1);
+        draw_layout(entry->quads, entry->count, origin_x, origin_y, rgba,
+                    atlases);
+        width  = entry->width;
+        height = entry->height;
+    }
+    else
+    {
+        int complete =
+            draw_string_layout(fnt, atlases, string, key.fraction_x,
+                               key.fraction_y, &width, &height);
+        const struct layout_quad *quads = layout.scratch->items;
+
+        if (layout.budget)
+        {
+            STATS_ADD(layout_misses, 1);
+            if (complete)
+                layout_insert(&key, quads, layout.scratch->size, width,
+                              height);
+        }
+        draw_layout(quads, layout.scratch->size, origin_x, origin_y, rgba,
+                    atlases);
     }
 
     if (out_x)
-        *out_x = pen_x - x;
+        *out_x = width;
     if (out_y)
-        *out_y = size_y;
+        *out_y = height;
 }
 
 void glez_string(float x, float y, const char *string, glez_font_t font,
                  glez_rgba_t color, float *out_x, float *out_y)
 {
-    texture_font_t *fnt = internal_font_get(font);
+    if (capture.recording)
+    {
+        struct capture_string record = { x, y, font, color };
+        capture_write(CAPTURE_OP_STRING, &record, sizeof(record), string);
+    }
 
-    ds_bind_texture(fnt->atlas->id);
+    texture_font_t *fnt           = internal_font_get(font);
+    internal_atlas_set_t *atlases = internal_font_atlases(font);
+    list_use_font(font);
 
     fnt->rendermode        = RENDER_NORMAL;
     fnt->outline_thickness = 0.0f;
 
-    draw_string_internal(x, y, string, fnt, color, out_x, out_y);
+    draw_string_internal(x, y, string, fnt, atlases, color, out_x, out_y);
 }
 
 void glez_string_with_outline(float x, float y, const char *string,
@@ -290,23 +537,43 @@ void glez_string_with_outline(float x, float y, const char *string,
                               int adjust_outline_alpha, float *out_x,
                               float *out_y)
 {
+    if (capture.recording)
+    {
+        struct capture_string_outline record = {
+            x, y, font, color, outline_color, outline_width,
+            adjust_outline_alpha
+        };
+        capture_write(CAPTURE_OP_STRING_OUTLINE, &record, sizeof(record),
+                      string);
+    }
+
     if (adjust_outline_alpha)
         outline_color.a = color.a;
 
-    texture_font_t *fnt = internal_font_get(font);
+    texture_font_t *fnt           = internal_font_get(font);
+    internal_atlas_set_t *atlases = internal_font_atlases(font);
+    list_use_font(font);
 
     fnt->rendermode        = RENDER_OUTLINE_POSITIVE;
     fnt->outline_thickness = outline_width;
-    draw_string_internal(x, y, string, fnt, outline_color, NULL, NULL);
+    draw_string_internal(x, y, string, fnt, atlases, outline_color, NULL,
+                         NULL);
 
     fnt->rendermode        = RENDER_NORMAL;
     fnt->outline_thickness = 0.0f;
-    draw_string_internal(x, y, string, fnt, color, out_x, out_y);
+    draw_string_internal(x, y, string, fnt, atlases, color, out_x, out_y);
 }
 
 void glez_circle(float x, float y, float radius, glez_rgba_t color,
                  float thickness, int steps)
 {
+    if (capture.recording)
+    {
+        struct capture_circle record = { x, y, radius, color, thickness,
+                                         steps };
+        capture_write(CAPTURE_OP_CIRCLE, &record, sizeof(record), NULL);
+    }
+
     float px = 0;
     float py = 0;
     for (int i = 0; i < steps; i++)
@@ -315,8 +582,8 @@ void glez_circle(float x, float y, float radius, glez_rgba_t color,
         if (!i)
             ang = 2 * M_PI * ((float) (steps - 1) / steps);
         if (i)
-            glez_line(px, py, x - px + radius * cos(ang),
-                      y - py + radius * sin(ang), color, thickness);
+            draw_line_internal(px, py, x - px + radius * cos(ang),
+                               y - py + radius * sin(ang), color, thickness);
         px = x + radius * cos(ang);
         py = y + radius * sin(ang);
     }
@@ -0,0 +1,202 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal/layout.h"
+
+struct layout_cache layout;
+
+static uint64_t layout_hash_bytes(uint64_t hash, const void *data,
+                                  size_t length)
+{
+    const unsigned char *bytes = data;
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+void layout_key_hash(struct layout_key *key)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    key->length = strlen(key->string);
+    hash = layout_hash_bytes(hash, &key->font, sizeof(key->font));
+    hash = layout_hash_bytes(hash, &key->rendermode, sizeof(key->rendermode));
+    hash = layout_hash_bytes(hash, &key->outline_thickness,
+                             sizeof(key->outline_thickness));
+    hash = layout_hash_bytes(hash, &key->fraction_x, sizeof(key->fraction_x));
+    hash = layout_hash_bytes(hash, &key->fraction_y, sizeof(key->fraction_y));
+    key->hash = layout_hash_bytes(hash, key->string, key->length);
+}
+
+static int layout_key_equal(const struct layout_key *a,
+                            const struct layout_key *b)
+{
+    return a->hash == b->hash && a->font == b->font &&
+           a->rendermode == b->rendermode &&
+           a->outline_thickness == b->outline_thickness &&
+           a->fraction_x == b->fraction_x && a->fraction_y == b->fraction_y &&
+           a->length == b->length && !memcmp(a->string, b->string, a->length);
+}
+
+static struct layout_entry **layout_bucket(uint64_t hash)
+{
+    return &layout.buckets[hash & (layout.bucket_count - 1)];
+}
+
+static void layout_unlink(struct layout_entry *entry)
+{
+    if (entry->newer)
+        entry->newer->older = entry->older;
+    else
+        layout.newest = entry->older;
+    if (entry->older)
+        entry->older->newer = entry->newer;
+    else
+        layout.oldest = entry->newer;
+}
+
+static void layout_push_newest(struct layout_entry *entry)
+{
+    entry->newer = NULL;
+    entry->older = layout.newest;
+    if (layout.newest)
+        layout.newest->newer = entry;
+    else
+        layout.oldest = entry;
+    layout.newest = entry;
+}
+
+static void layout_remove(struct layout_entry *entry)
+{
+    struct layout_entry **link = layout_bucket(entry->key.hash);
+
+    while (*link != entry)
+        link = &(*link)->next;
+    *link = entry->next;
+    layout_unlink(entry);
+    layout.bytes -= entry->bytes;
+    layout.entries--;
+    free(entry);
+}
+
+/* Keeps at most one entry per bucket on average */
+static void layout_grow()
+{
+    size_t count                  = layout.bucket_count * 2;
+    size_t old_count              = layout.bucket_count;
+    struct layout_entry **old     = layout.buckets;
+    struct layout_entry **buckets = calloc(count, sizeof(*buckets));
+
+    if (buckets == NULL)
+        return;
+    layout.buckets      = buckets;
+    layout.bucket_count = count;
+    for (size_t i = 0; i < old_count; ++i)
+    {
+        struct layout_entry *entry = old[i];
+
+        while (entry)
+        {
+            struct layout_entry *next  = entry->next;
+            struct layout_entry **link = layout_bucket(entry->key.hash);
+
+            entry->next = *link;
+            *link       = entry;
+            entry       = next;
+        }
+    }
+    free(old);
+}
+
+void layout_init(size_t budget)
+{
+    memset(&layout, 0, sizeof(layout));
+    layout.scratch = vector_new(sizeof(struct layout_quad));
+    if (budget == 0)
+        return;
+    layout.bucket_count = 256;
+    layout.buckets      = calloc(layout.bucket_count, sizeof(*layout.buckets));
+    if (layout.buckets)
+        layout.budget = budget;
+}
+
+void layout_destroy()
+{
+    while (layout.oldest)
+        layout_remove(layout.oldest);
+    free(layout.buckets);
+    vector_delete(layout.scratch);
+    memset(&layout, 0, sizeof(layout));
+}
+
+const struct layout_entry *layout_find(const struct layout_key *key)
+{
+    struct layout_entry *entry;
+
+    if (layout.budget == 0)
+        return NULL;
+    entry = *layout_bucket(key->hash);
+    while (entry && !layout_key_equal(&entry->key, key))
+        entry = entry->next;
+    if (entry && entry != layout.newest)
+    {
+        layout_unlink(entry);
+        layout_push_newest(entry);
+    }
+    return entry;
+}
+
+void layout_insert(const struct layout_key *key,
+                   const struct layout_quad *quads, size_t count,
+                   float width, float height)
+{
+    size_t bytes = sizeof(struct layout_entry) +
+                   count * sizeof(struct layout_quad) + key->length + 1;
+    struct layout_entry *entry;
+    char *string;
+
+    if (bytes > layout.budget)
+        return;
+    while (layout.bytes + bytes > layout.budget)
+        layout_remove(layout.oldest);
+
+    entry = malloc(bytes);
+    if (entry == NULL)
+        return;
+    string = (char *) (entry->quads + count);
+    memcpy(entry->quads, quads, count * sizeof(struct layout_quad));
+    memcpy(string, key->string, key->length + 1);
+    entry->key        = *key;
+    entry->key.string = string;
+    entry->width      = width;
+    entry->height     = height;
+    entry->count      = count;
+    entry->bytes      = bytes;
+
+    if (layout.entries >= layout.bucket_count)
+        layout_grow();
+    struct layout_entry **link = layout_bucket(key->hash);
+    entry->next                = *link;
+    *link                      = entry;
+    layout_push_newest(entry);
+    layout.bytes += bytes;
+    layout.entries++;
+}
+
+void layout_forget_font(const texture_font_t *font)
+{
+    struct layout_entry *entry = layout.oldest;
+
+    while (entry)
+    {
+        struct layout_entry *newer = entry->newer;
+
+        if (entry->key.font == font)
+            layout_remove(entry);
+        entry = newer;
+    }
+}
@@ -0,0 +1,261 @@
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include <assert.h>
+#include <string.h>
+
+#include "glez.h"
+
+#include "internal/capture.h"
+#include "internal/list.h"
+#include "internal/program.h"
+#include "internal/fonts.h"
+#include "internal/stats.h"
+#include "internal/software.h"
+#include "internal/trace.h"
+
+struct list_state lists;
+
+static struct list_t *list_get(glez_list_t list)
+{
+    assert(list < GLEZ_LIST_COUNT);
+    assert(lists.lists[list].init);
+    return &lists.lists[list];
+}
+
+static size_t list_segment_start(struct list_t *list)
+{
+    const struct list_segment *last;
+
+    if (list->segments->size == 0)
+        return 0;
+    last = vector_back(list->segments);
+    return last->first + last->quads;
+}
+
+struct vertex_main *list_push_quads(size_t count)
+{
+    vector_t *vertices = lists.recording->vertices;
+    size_t size        = vertices->size;
+
+    vector_resize(vertices, size + count * 4);
+    return (struct vertex_main *) vector_get(vertices, size);
+}
+
+void list_close_segment()
+{
+    struct list_t *list = lists.recording;
+    struct list_segment segment;
+
+    segment.first = list_segment_start(list);
+    segment.quads = list->vertices->size / 4 - segment.first;
+    if (segment.quads == 0)
+        return;
+    segment.modes      = program.batch_modes;
+    segment.slot_count = ds.slot_count;
+    memcpy(segment.slots, ds.slots, sizeof(segment.slots));
+    memcpy(segment.images, ds.images, sizeof(segment.images));
+    vector_push_back(list->segments, &segment);
+}
+
+void list_use_font(glez_font_t font)
+{
+    if (lists.recording)
+        lists.recording->fonts[font] = lists.font_generations[font] + 1;
+}
+
+void list_use_texture(glez_texture_t texture)
+{
+    if (lists.recording)
+        lists.recording->textures[texture] =
+            lists.texture_generations[texture] + 1;
+}
+
+void list_font_unloaded(glez_font_t font)
+{
+    lists.font_generations[font]++;
+}
+
+void list_texture_unloaded(glez_texture_t texture)
+{
+    lists.texture_generations[texture]++;
+}
+
+void lists_destroy()
+{
+    for (glez_list_t i = 0; i < GLEZ_LIST_COUNT; ++i)
+    {
+        if (lists.lists[i].init)
+            glez_list_free(i);
+    }
+}
+
+void lists_capture()
+{
+    for (glez_list_t i = 0; i < GLEZ_LIST_COUNT; ++i)
+    {
+        struct capture_handle record = { i };
+
+        if (!lists.lists[i].init)
+            continue;
+        /* Their vertices are not kept: glez_list_valid fails until they
+           are recorded again in a captured frame */
+        lists.lists[i].captured = 0;
+        capture_write(CAPTURE_OP_LIST_NEW, &record, sizeof(record), NULL);
+        if (capture.file == NULL)
+            return;
+    }
+}
+
+static int list_resources_valid(const struct list_t *l)
+{
+    for (int i = 0; i < GLEZ_FONT_COUNT; ++i)
+    {
+        if (l->fonts[i] && l->fonts[i] != lists.font_generations[i] + 1)
+            return 0;
+    }
+    for (int i = 0; i < GLEZ_TEXTURE_COUNT; ++i)
+    {
+        if (l->textures[i] &&
+            l->textures[i] != lists.texture_generations[i] + 1)
+            return 0;
+    }
+    return 1;
+}
+
+glez_list_t glez_list_new()
+{
+    for (glez_list_t i = 0; i < GLEZ_LIST_COUNT; ++i)
+    {
+        struct list_t *list = &lists.lists[i];
+
+        if (list->init)
+            continue;
+        memset(list, 0, sizeof(*list));
+        list->vertices = vector_new(sizeof(struct vertex_main));
+        list->segments = vector_new(sizeof(struct list_segment));
+        if (!software.enabled)
+            glGenBuffers(1, &list->buffer);
+        list->init = 1;
+        if (capture.file)
+        {
+            struct capture_handle record = { i };
+            capture_write(CAPTURE_OP_LIST_NEW, &record, sizeof(record), NULL);
+        }
+        return i;
+    }
+    return GLEZ_LIST_INVALID;
+}
+
+void glez_list_free(glez_list_t list)
+{
+    struct list_t *l = list_get(list);
+
+    assert(lists.recording != l);
+    if (capture.file)
+    {
+        struct capture_handle record = { list };
+        capture_write(CAPTURE_OP_LIST_FREE, &record, sizeof(record), NULL);
+    }
+    if (l->buffer)
+    {
+        /* A buffer created later may get the same name */
+        if (program.vao_buffer == l->buffer)
+            program.vao_buffer = 0;
+        glDeleteBuffers(1, &l->buffer);
+    }
+    vector_delete(l->vertices);
+    vector_delete(l->segments);
+    l->init = 0;
+}
+
+void glez_list_begin(glez_list_t list)
+{
+    struct list_t *l = list_get(list);
+
+    assert(lists.recording == NULL);
+    if (capture.recording)
+    {
+        struct capture_handle record = { list };
+        capture_write(CAPTURE_OP_LIST_BEGIN, &record, sizeof(record), NULL);
+    }
+
+    /* The list starts from empty texture slots, like a new batch */
+    program_draw(FLUSH_LIST);
+    program_reset();
+    ds.slot_count = 0;
+
+    vector_clear(l->vertices);
+    vector_clear(l->segments);
+    memset(l->fonts, 0, sizeof(l->fonts));
+    memset(l->textures, 0, sizeof(l->textures));
+    l->quads        = 0;
+    l->captured     = capture.recording;
+    lists.recording = l;
+}
+
+void glez_list_end()
+{
+    struct list_t *l = lists.recording;
+
+    assert(l != NULL);
+    if (capture.recording)
+        capture_write(CAPTURE_OP_LIST_END, NULL, 0, NULL);
+    list_close_segment();
+    program_reset();
+    lists.recording = NULL;
+    ds.slot_count   = 0;
+    l->quads        = l->vertices->size / 4;
+
+    /* Glyphs rasterized while recording are drawn by the list right away,
+       their atlas has to be on the GPU before it is replayed */
+    for (glez_font_t i = 0; i < GLEZ_FONT_COUNT; ++i)
+    {
+        if (l->fonts[i] != lists.font_generations[i] + 1)
+            continue;
+        internal_atlas_set_t *atlases = internal_font_atlases(i);
+        for (unsigned page = 0; page < atlases->count; ++page)
+            internal_font_upload_atlas(atlases->pages[page]);
+    }
+
+    if (software.enabled)
+        return;
+
+    double trace_start = trace_begin();
+    size_t bytes       = l->vertices->size * sizeof(struct vertex_main);
+
+    glBindBuffer(GL_ARRAY_BUFFER, l->buffer);
+    glBufferData(GL_ARRAY_BUFFER, bytes, l->vertices->items, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    vector_clear(l->vertices);
+    STATS_ADD(vertex_upload_bytes, bytes);
+    trace_complete("list upload", trace_start, "bytes", bytes, NULL, NULL);
+}
+
+int glez_list_valid(glez_list_t list)
+{
+    struct list_t *l = list_get(list);
+
+    /* A capture has to see the list recorded to replay its draws */
+    if (capture.file && !l->captured)
+        return 0;
+    return list_resources_valid(l);
+}
+
+void glez_list_draw(glez_list_t list, float dx, float dy)
+{
+    struct list_t *l = list_get(list);
+
+    assert(lists.recording == NULL);
+    if (capture.recording)
+    {
+        struct capture_list_draw record = { list, dx, dy };
+        capture_write(CAPTURE_OP_LIST_DRAW, &record, sizeof(record), NULL);
+    }
+    if (l->quads == 0 || !list_resources_valid(l))
+        return;
+
+    program_draw(FLUSH_LIST);
+    program_reset();
+    program_draw_list(l, dx, dy);
+}
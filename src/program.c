@@ -3,17 +3,27 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <mat4.h>
 
 #include "internal/program.h"
+#include "internal/stream.h"
+#include "internal/stats.h"
+#include "internal/binary.h"
+#include "internal/timer.h"
+#include "internal/software.h"
+#include "internal/trace.h"
+#include "internal/list.h"
 
-GLuint compile_shader(const char *source, GLenum type)
+GLuint compile_shader(const char *header, const char *defines,
+                      const char *source, GLenum type)
 {
     GLint status;
-    GLuint shader = glCreateShader(type);
+    GLuint shader         = glCreateShader(type);
+    const char *sources[] = { header, defines, source };
 
-    glShaderSource(shader, 1, &source, 0);
+    glShaderSource(shader, 3, sources, 0);
     glCompileShader(shader);
     glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
 
@@ -29,17 +39,30 @@ GLuint compile_shader(const char *source, GLenum type)
     return shader;
 }
 
-const char *shader_ultimate_vert =
+/* Prepended to the shaders below, indexed by GLEZ_PROFILE_* */
+const char *shader_vert_headers[] = { "#version 130\n", "#version 330 core\n",
+                                      "#version 300 es\n" };
+const char *shader_frag_headers[] = {
     "#version 130\n"
-    "\n"
+    "#define frag_Output gl_FragColor\n",
+    "#version 330 core\n"
+    "out vec4 frag_Output;\n",
+    "#version 300 es\n"
+    "precision highp float;\n"
+    "precision highp sampler2D;\n"
+    "out vec4 frag_Output;\n"
+};
+
+const char *shader_ultimate_vert =
     "uniform mat4 model;\n"
     "uniform mat4 view;\n"
     "uniform mat4 projection;\n"
     "in vec2 vertex;\n"
     "in vec2 tex_coord;\n"
     "in vec4 color;\n"
-    "in int drawmode;\n"
+    "in uvec4 drawmode;\n"
     "flat out int frag_DrawMode;\n"
+    "flat out int frag_Slot;\n"
     "out vec4 frag_Color;\n"
     "out vec2 frag_TexCoord;\n"
     "void main()\n"
@@ -47,64 +70,152 @@ const char *shader_ultimate_vert =
     "    frag_TexCoord = tex_coord;\n"
     "    frag_Color    = color;\n"
     "    gl_Position   = projection*(view*(model*vec4(vertex,0.0,1.0)));\n"
-    "    frag_DrawMode = drawmode;\n"
+    "    frag_DrawMode = int(drawmode.x);\n"
+    "    frag_Slot     = int(drawmode.y);\n"
     "}";
+/* DRAW_MODE selects the variant: 0 branches on frag_DrawMode, otherwise
+   the shader only implements that mode */
 const char *shader_ultimate_frag =
-    "#version 130\n"
-    "\n"
-    "uniform sampler2D texture;\n"
     "in vec4 frag_Color;\n"
     "in vec2 frag_TexCoord;\n"
     "flat in int frag_DrawMode;\n"
+    "flat in int frag_Slot;\n"
+    "#if DRAW_MODE != 1\n"
+    "uniform sampler2D textures[8];\n"
+    "vec4 sample_slot(vec2 coord)\n"
+    "{\n"
+    "    if (frag_Slot == 0) return texture(textures[0], coord);\n"
+    "    if (frag_Slot == 1) return texture(textures[1], coord);\n"
+    "    if (frag_Slot == 2) return texture(textures[2], coord);\n"
+    "    if (frag_Slot == 3) return texture(textures[3], coord);\n"
+    "    if (frag_Slot == 4) return texture(textures[4], coord);\n"
+    "    if (frag_Slot == 5) return texture(textures[5], coord);\n"
+    "    if (frag_Slot == 6) return texture(textures[6], coord);\n"
+    "    return texture(textures[7], coord);\n"
+    "}\n"
+    "#endif\n"
     "void main()\n"
     "{\n"
+    "#if DRAW_MODE == 1\n"
+    "   frag_Output = frag_Color;\n"
+    "#elif DRAW_MODE == 2\n"
+    "   frag_Output = frag_Color * sample_slot(frag_TexCoord);\n"
+    "#elif DRAW_MODE == 3\n"
+    "   frag_Output = vec4(frag_Color.rgb,\n"
+    "                      frag_Color.a * sample_slot(frag_TexCoord).r);\n"
+    "#else\n"
     "   if (frag_DrawMode == 1)\n"
-    "       gl_FragColor = frag_Color;\n"
+    "       frag_Output = frag_Color;\n"
     "   else\n"
     "   {\n"
-    "       vec4 tex = texture2D(texture, frag_TexCoord);\n"
+    "       vec4 tex = sample_slot(frag_TexCoord);\n"
     "       if (frag_DrawMode == 2)\n"
-    "           gl_FragColor = frag_Color * tex;\n"
+    "           frag_Output = frag_Color * tex;\n"
     "       else if (frag_DrawMode == 3)\n"
     "       {\n"
-    "           gl_FragColor = vec4(frag_Color.rgb, frag_Color.a * tex.r);\n"
+    "           frag_Output = vec4(frag_Color.rgb, frag_Color.a * tex.r);\n"
     "       }\n"
     "       else\n"
-    "           gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);\n"
+    "           frag_Output = vec4(0.0, 0.0, 0.0, 1.0);\n"
     "    }\n"
+    "#endif\n"
     "}";
 
+/* Indexed by draw mode, 0 is the ubershader */
+const char *shader_variant_defines[] = {
+    "#define DRAW_MODE 0\n", "#define DRAW_MODE 1\n", "#define DRAW_MODE 2\n",
+    "#define DRAW_MODE 3\n"
+};
+
 void shader_screen_size(int width, int height)
 {
-    glUseProgram(program.shader);
     mat4 projection;
     mat4_set_identity(&projection);
     mat4_set_orthographic(&projection, 0, width, height, 0, -1, 1);
-    glUniformMatrix4fv(glGetUniformLocation(program.shader, "projection"), 1, 0,
-                       projection.data);
+    for (int i = 0; i < DRAW_MODE_COUNT; ++i)
+    {
+        if (program.shaders[i] == 0)
+            continue;
+        glUseProgram(program.shaders[i]);
+        glUniformMatrix4fv(glGetUniformLocation(program.shaders[i],
+                                                "projection"),
+                           1, 0, projection.data);
+    }
     glUseProgram(0);
 }
 
-void program_init(int width, int height)
+const char *program_vertex_format =
+    "vertex:2f,tex_coord:2Sn,color:4Bn,drawmode:4B";
+
+static uint64_t program_cache_key(const glez_options_t *options, int mode)
+{
+    uint64_t hash = 0;
+
+    hash = binary_cache_hash(hash, shader_vert_headers[options->profile]);
+    hash = binary_cache_hash(hash, shader_ultimate_vert);
+    hash = binary_cache_hash(hash, shader_frag_headers[options->profile]);
+    hash = binary_cache_hash(hash, shader_variant_defines[mode]);
+    hash = binary_cache_hash(hash, shader_ultimate_frag);
+    hash = binary_cache_hash(hash, program_vertex_format);
+    return binary_cache_key(hash);
+}
+
+static GLuint program_link(const glez_options_t *options, int mode)
 {
-    program.buffer =
-        vertex_buffer_new("vertex:2f,tex_coord:2f,color:4f,drawmode:1i");
-    program.shader = glCreateProgram();
+    GLuint shader = glCreateProgram();
+    uint64_t key  = 0;
+    double start  = stats_now();
+
+    if (binary_cache.enabled)
+    {
+        key = program_cache_key(options, mode);
+        if (binary_cache_load(shader, key))
+        {
+            stats.init.programs_cached++;
+            stats.init.programs_ms += (stats_now() - start) * 1000.0;
+            return shader;
+        }
+    }
+
     GLint status;
-    GLuint sh_frag = compile_shader(shader_ultimate_frag, GL_FRAGMENT_SHADER);
-    glAttachShader(program.shader, sh_frag);
+    GLuint sh_frag = compile_shader(shader_frag_headers[options->profile],
+                                    shader_variant_defines[mode],
+                                    shader_ultimate_frag, GL_FRAGMENT_SHADER);
+    glAttachShader(shader, sh_frag);
     glDeleteShader(sh_frag);
 
-    GLuint sh_vert = compile_shader(shader_ultimate_vert, GL_VERTEX_SHADER);
-    glAttachShader(program.shader, sh_vert);
+    GLuint sh_vert = compile_shader(shader_vert_headers[options->profile], "",
+                                    shader_ultimate_vert, GL_VERTEX_SHADER);
+    glAttachShader(shader, sh_vert);
     glDeleteShader(sh_vert);
 
-    glLinkProgram(program.shader);
-    glGetProgramiv(program.shader, GL_LINK_STATUS, &status);
+    for (int i = 0; i < MAX_VERTEX_ATTRIBUTE; ++i)
+    {
+        vertex_attribute_t *attribute = program.buffer->attributes[i];
+        if (attribute == NULL)
+            continue;
+        glBindAttribLocation(shader, i, attribute->name);
+    }
+
+    if (binary_cache.enabled)
+        glProgramParameteri(shader, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                            GL_TRUE);
+    glLinkProgram(shader);
+    glGetProgramiv(shader, GL_LINK_STATUS, &status);
 
     assert(status == GL_TRUE);
 
-    glUseProgram(program.shader);
+    if (binary_cache.enabled)
+        binary_cache_store(shader, key);
+
+    stats.init.programs_compiled++;
+    stats.init.programs_ms += (stats_now() - start) * 1000.0;
+    return shader;
+}
+
+static void program_setup_uniforms(GLuint shader, int width, int height)
+{
+    glUseProgram(shader);
 
     mat4 model, view, projection;
 
@@ -113,30 +224,330 @@ void program_init(int width, int height)
     mat4_set_identity(&projection);
     mat4_set_orthographic(&projection, 0, width, height, 0, -1, 1);
 
-    glUniformMatrix4fv(glGetUniformLocation(program.shader, "model"), 1, 0,
+    glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, 0,
                        model.data);
-    glUniformMatrix4fv(glGetUniformLocation(program.shader, "view"), 1, 0,
-                       view.data);
-    glUniformMatrix4fv(glGetUniformLocation(program.shader, "projection"), 1, 0,
+    glUniformMatrix4fv(glGetUniformLocation(shader, "view"), 1, 0, view.data);
+    glUniformMatrix4fv(glGetUniformLocation(shader, "projection"), 1, 0,
                        projection.data);
-    glUniform1i(glGetUniformLocation(program.shader, "texture"), 0);
+    GLint units[GLEZ_MAX_TEXTURE_SLOTS];
+    for (int i = 0; i < GLEZ_MAX_TEXTURE_SLOTS; ++i)
+        units[i] = i;
+    glUniform1iv(glGetUniformLocation(shader, "textures"),
+                 GLEZ_MAX_TEXTURE_SLOTS, units);
 
     glUseProgram(0);
 }
 
-void program_draw()
+void program_init(int width, int height, const glez_options_t *options)
+{
+    program.buffer = vertex_buffer_new(program_vertex_format);
+    vector_reserve(program.buffer->vertices, 4096 * 4);
+    /* Bound at link time, and kept by cached binaries */
+    for (int i = 0; i < MAX_VERTEX_ATTRIBUTE; ++i)
+    {
+        if (program.buffer->attributes[i])
+            program.buffer->attributes[i]->index = i;
+    }
+
+    /* Quads stay in program.buffer for the rasterizer, nothing else is
+       needed */
+    if (software.enabled)
+        return;
+
+    binary_cache_init(options->binary_cache_dir);
+    program.variants = options->shader_variants;
+    for (int i = 0; i < DRAW_MODE_COUNT; ++i)
+    {
+        if (i != 0 && program.variants == GLEZ_SHADERS_UBER)
+            continue;
+        if (i == 0 && program.variants == GLEZ_SHADERS_SPLIT)
+            continue;
+        program.shaders[i] = program_link(options, i);
+        program_setup_uniforms(program.shaders[i], width, height);
+        program.model_locations[i] =
+            glGetUniformLocation(program.shaders[i], "model");
+    }
+
+    /* glez_init runs outside any state guard: the host's vertex array
+       and array buffer stay bound */
+    GLint host_vertex_array;
+    GLint host_array_buffer;
+
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &host_vertex_array);
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &host_array_buffer);
+
+    glGenVertexArrays(1, &program.vao);
+    glBindVertexArray(program.vao);
+    glGenBuffers(1, &program.quad_indices);
+    program_reserve_quads(1024);
+    glBindVertexArray(host_vertex_array);
+
+    stream_init(4096 * 4 * sizeof(struct vertex_main),
+                options->streaming == GLEZ_STREAMING_RING);
+    glBindBuffer(GL_ARRAY_BUFFER, host_array_buffer);
+}
+
+void program_destroy()
+{
+    if (program.buffer)
+        vertex_buffer_delete(program.buffer);
+    if (!software.enabled)
+    {
+        for (int i = 0; i < DRAW_MODE_COUNT; ++i)
+        {
+            if (program.shaders[i])
+                glDeleteProgram(program.shaders[i]);
+        }
+        glDeleteVertexArrays(1, &program.vao);
+        glDeleteBuffers(1, &program.quad_indices);
+    }
+    /* A later glez_init, maybe in another context, starts from scratch:
+       stale names and capacities would point at nothing */
+    memset(&program, 0, sizeof(program));
+}
+
+void program_reserve_quads(size_t count)
+{
+    size_t capacity = program.quad_capacity ? program.quad_capacity : 1;
+
+    if (count <= program.quad_capacity)
+        return;
+
+    while (capacity < count)
+        capacity *= 2;
+
+    GLuint *indices = malloc(capacity * 6 * sizeof(GLuint));
+    assert(indices != NULL);
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        GLuint vertex      = i * 4;
+        indices[i * 6]     = vertex;
+        indices[i * 6 + 1] = vertex + 1;
+        indices[i * 6 + 2] = vertex + 2;
+        indices[i * 6 + 3] = vertex + 2;
+        indices[i * 6 + 4] = vertex + 3;
+        indices[i * 6 + 5] = vertex;
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, program.quad_indices);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, capacity * 6 * sizeof(GLuint),
+                 indices, GL_STATIC_DRAW);
+    free(indices);
+
+    program.quad_capacity = capacity;
+}
+
+static size_t program_pending_quads()
 {
-    glUseProgram(program.shader);
-    vertex_buffer_render(program.buffer, GL_TRIANGLES);
+    if (stream.mode == STREAM_PERSISTENT)
+        return (stream.end - stream.start) / (4 * sizeof(struct vertex_main));
+    return program.buffer->vertices->size / 4;
+}
+
+/* Points the attributes of program.vao at buffer: the stream buffer, only
+   needed again when the stream replaces it, or a list buffer. */
+static void program_setup_vao(GLuint buffer)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (int i = 0; i < MAX_VERTEX_ATTRIBUTE; ++i)
+    {
+        if (program.buffer->attributes[i])
+            vertex_attribute_enable(program.buffer->attributes[i]);
+    }
+    program.vao_buffer = buffer;
+}
+
+void program_begin()
+{
+    program.active = -1;
+    glBindVertexArray(program.vao);
+}
+
+/* Picks the specialized shader when the batch holds a single draw mode */
+static int program_batch_variant()
+{
+    if (program.variants == GLEZ_SHADERS_UBER)
+        return 0;
+    for (int mode = 1; mode < DRAW_MODE_COUNT; ++mode)
+    {
+        if (program.batch_modes == (1u << mode))
+            return mode;
+    }
+    return 0;
+}
+
+/* Makes the variant current with its model uniform translated by dx, dy */
+static void program_use(int variant, float dx, float dy)
+{
+    float *offset = program.offsets[variant];
+
+    if (variant != program.active)
+    {
+        glUseProgram(program.shaders[variant]);
+        program.active = variant;
+    }
+    if (offset[0] != dx || offset[1] != dy)
+    {
+        mat4 model;
+
+        mat4_set_translation(&model, dx, dy, 0);
+        glUniformMatrix4fv(program.model_locations[variant], 1, 0,
+                           model.data);
+        offset[0] = dx;
+        offset[1] = dy;
+    }
+}
+
+void program_end()
+{
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
     glUseProgram(0);
 }
 
+static const char *program_flush_reasons[FLUSH_REASON_COUNT] = {
+    "end of frame", "texture slots", "draw mode", "buffer full", "list"
+};
+
+void program_draw(int reason)
+{
+    size_t quads = program_pending_quads();
+    size_t offset;
+
+    if (lists.recording)
+    {
+        list_close_segment();
+        return;
+    }
+    if (quads == 0)
+        return;
+
+    STATS_TIMER(start);
+    double trace_start = trace_begin();
+    if (software.enabled)
+    {
+        STATS_ADD(draw_calls, 1);
+        STATS_ADD(vertices, quads * 4);
+        STATS_ADD(indices, quads * 6);
+        software_draw(program.buffer->vertices->items, quads, ds.images, 0,
+                      0);
+        STATS_ADD_MS(flush_ms, start);
+        trace_complete("flush", trace_start, "quads", quads, "reason",
+                       program_flush_reasons[reason]);
+        return;
+    }
+
+    program_reserve_quads(quads);
+    STATS_ADD(draw_calls, 1);
+    STATS_ADD(vertices, quads * 4);
+    STATS_ADD(indices, quads * 6);
+    STATS_ADD(vertex_upload_bytes, quads * 4 * sizeof(struct vertex_main));
+
+    if (stream.mode == STREAM_PERSISTENT)
+        offset = stream.segment * stream.segment_size + stream.start;
+    else
+        offset = stream_upload(program.buffer->vertices->items,
+                               quads * 4 * sizeof(struct vertex_main));
+
+    if (program.vao_buffer != stream.buffer)
+        program_setup_vao(stream.buffer);
+    program_use(program_batch_variant(), 0, 0);
+
+    timer_begin_flush();
+    if (offset == 0)
+        glDrawElements(GL_TRIANGLES, quads * 6, GL_UNSIGNED_INT, 0);
+    else
+        glDrawElementsBaseVertex(GL_TRIANGLES, quads * 6, GL_UNSIGNED_INT, 0,
+                                 offset / sizeof(struct vertex_main));
+    timer_end_flush();
+    STATS_ADD_MS(flush_ms, start);
+    trace_complete("flush", trace_start, "quads", quads, "reason",
+                   program_flush_reasons[reason]);
+}
+
 void program_reset()
 {
-    vertex_buffer_clear(program.buffer);
+    program.batch_modes = 0;
+    if (stream.mode == STREAM_PERSISTENT)
+        stream.start = stream.end;
+    else
+        vertex_buffer_clear(program.buffer);
 }
 
-unsigned program_next_index()
+void program_draw_list(const struct list_t *list, float dx, float dy)
 {
-    return program.buffer->vertices->size;
+    const struct list_segment *segments = list->segments->items;
+    const struct vertex_main *vertices  = list->vertices->items;
+
+    STATS_TIMER(start);
+    double trace_start = trace_begin();
+    if (!software.enabled)
+    {
+        program_reserve_quads(list->quads);
+        program_setup_vao(list->buffer);
+    }
+
+    for (size_t i = 0; i < list->segments->size; ++i)
+    {
+        const struct list_segment *segment = &segments[i];
+
+        /* Same units as when recorded */
+        ds.slot_count = 0;
+        for (int slot = 0; slot < segment->slot_count; ++slot)
+            ds_bind_texture(segment->slots[slot], &segment->images[slot]);
+
+        STATS_ADD(draw_calls, 1);
+        STATS_ADD(vertices, segment->quads * 4);
+        STATS_ADD(indices, segment->quads * 6);
+        if (software.enabled)
+        {
+            software_draw(vertices + segment->first * 4, segment->quads,
+                          ds.images, dx, dy);
+            continue;
+        }
+
+        program.batch_modes = segment->modes;
+        program_use(program_batch_variant(), dx, dy);
+        program.batch_modes = 0;
+
+        /* The shared indices repeat every quad, starting at the segment's
+           first quad makes them point at its vertices */
+        timer_begin_flush();
+        glDrawElements(GL_TRIANGLES, segment->quads * 6, GL_UNSIGNED_INT,
+                       (void *) (segment->first * 6 * sizeof(GLuint)));
+        timer_end_flush();
+    }
+    STATS_ADD_MS(flush_ms, start);
+    trace_complete("list draw", trace_start, "quads", list->quads, NULL,
+                   NULL);
+}
+
+struct vertex_main *program_push_quads(size_t count, int mode)
+{
+    size_t bytes;
+
+    if (program.variants == GLEZ_SHADERS_SPLIT && program.batch_modes &&
+        program.batch_modes != (1u << mode))
+    {
+        program_draw(FLUSH_DRAW_MODE);
+        program_reset();
+    }
+    program.batch_modes |= 1u << mode;
+
+    if (lists.recording)
+        return list_push_quads(count);
+    if (stream.mode != STREAM_PERSISTENT)
+        return vertex_buffer_alloc_vertices(program.buffer, count * 4);
+
+    bytes = count * 4 * sizeof(struct vertex_main);
+    if (!stream_fits(bytes))
+    {
+        program_draw(FLUSH_BUFFER_FULL);
+        program_reset();
+        stream_grow(bytes);
+        /* The new buffer may reuse the old name, which the VAO no longer
+           points at */
+        program.vao_buffer = 0;
+    }
+    return stream_alloc(bytes);
 }
@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal/raster.h"
+#include "internal/stats.h"
+#include "internal/trace.h"
+
+struct raster_state raster = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static size_t raster_bucket(const texture_font_t *font, uint32_t codepoint)
+{
+    return (((uintptr_t) font >> 4) ^ codepoint * 0x9E3779B1u) %
+           RASTER_BUCKETS;
+}
+
+static int raster_job_matches(const struct raster_job *job,
+                              const texture_font_t *font, uint32_t codepoint,
+                              rendermode_t rendermode, float outline_thickness)
+{
+    return job->font == font && job->codepoint == codepoint &&
+           job->rendermode == rendermode &&
+           job->outline_thickness == outline_thickness;
+}
+
+static void raster_unlink_pending(struct raster_job *job)
+{
+    struct raster_job **link =
+        &raster.pending[raster_bucket(job->font, job->codepoint)];
+
+    while (*link != job)
+        link = &(*link)->bucket_next;
+    *link = job->bucket_next;
+    raster.pending_count--;
+}
+
+static void raster_free_job(struct raster_job *job)
+{
+    raster_unlink_pending(job);
+    free(job->bitmap.buffer);
+    free(job);
+}
+
+/* Face of font the worker has opened, or NULL. Called with the lock held,
+   raster_forget_font edits the list. */
+static FT_Face raster_worker_find_face(struct raster_worker *worker,
+                                       const texture_font_t *font)
+{
+    struct raster_face *faces = worker->faces->items;
+
+    for (size_t i = 0; i < worker->faces->size; ++i)
+    {
+        if (faces[i].font == font)
+            return faces[i].face;
+    }
+    return NULL;
+}
+
+static void raster_render(struct raster_worker *worker, FT_Face face,
+                          struct raster_job *job)
+{
+    texture_glyph_bitmap_t *scratch = &worker->scratch;
+    double start                    = trace_begin();
+    size_t size;
+
+    if (face == NULL ||
+        !texture_font_render_glyph(job->font, worker->library, face,
+                                   job->codepoint, job->rendermode,
+                                   job->outline_thickness, scratch))
+        return;
+
+    size        = scratch->width * scratch->height * job->font->atlas->depth;
+    job->bitmap = *scratch;
+    job->bitmap.buffer   = malloc(size);
+    job->bitmap.capacity = size;
+    if (job->bitmap.buffer == NULL)
+        return;
+    memcpy(job->bitmap.buffer, scratch->buffer, size);
+    job->rendered = 1;
+    trace_complete("glyph rasterize", start, "codepoint", job->codepoint, NULL,
+                   NULL);
+}
+
+static void *raster_worker(void *argument)
+{
+    struct raster_worker *worker = argument;
+
+    pthread_mutex_lock(&raster.lock);
+    while (!raster.shutdown)
+    {
+        struct raster_job *job = raster.queued;
+
+        if (job == NULL)
+        {
+            pthread_cond_wait(&raster.start, &raster.lock);
+            continue;
+        }
+        raster.queued = job->next;
+        if (raster.queued == NULL)
+            raster.queued_tail = NULL;
+        worker->current = job;
+        FT_Face face    = raster_worker_find_face(worker, job->font);
+        pthread_mutex_unlock(&raster.lock);
+
+        /* Parsing the font file is slow, so it happens unlocked like the
+           rendering. worker->current keeps raster_forget_font from freeing
+           the font meanwhile, and the face is published with the job. */
+        struct raster_face opened = { job->font, NULL };
+        if (face == NULL)
+            face = opened.face =
+                texture_font_open_face(job->font, worker->library);
+        raster_render(worker, face, job);
+
+        pthread_mutex_lock(&raster.lock);
+        if (opened.face)
+            vector_push_back(worker->faces, &opened);
+        worker->current = NULL;
+        job->next       = NULL;
+        if (raster.finished_tail)
+            raster.finished_tail->next = job;
+        else
+            raster.finished = job;
+        raster.finished_tail = job;
+        pthread_cond_broadcast(&raster.idle);
+    }
+    pthread_mutex_unlock(&raster.lock);
+    return NULL;
+}
+
+void raster_init(const glez_options_t *options)
+{
+    raster.threads  = 0;
+    raster.shutdown = 0;
+    raster.budget   = options->glyph_upload_budget;
+    if (options->glyph_threads <= 0)
+        return;
+
+    raster.workers = calloc(options->glyph_threads, sizeof(*raster.workers));
+    if (raster.workers == NULL)
+        return;
+    pthread_cond_init(&raster.start, NULL);
+    pthread_cond_init(&raster.idle, NULL);
+    for (int i = 0; i < options->glyph_threads; ++i)
+    {
+        struct raster_worker *worker = &raster.workers[raster.threads];
+
+        if (FT_Init_FreeType(&worker->library))
+            break;
+        worker->faces = vector_new(sizeof(struct raster_face));
+        if (pthread_create(&worker->thread, NULL, raster_worker, worker))
+        {
+            perror("glez: could not start a glyph thread");
+            vector_delete(worker->faces);
+            FT_Done_FreeType(worker->library);
+            break;
+        }
+        raster.threads++;
+    }
+}
+
+void raster_destroy()
+{
+    if (raster.workers == NULL)
+        return;
+
+    pthread_mutex_lock(&raster.lock);
+    raster.shutdown = 1;
+    pthread_cond_broadcast(&raster.start);
+    pthread_mutex_unlock(&raster.lock);
+
+    for (int i = 0; i < raster.threads; ++i)
+    {
+        struct raster_worker *worker = &raster.workers[i];
+        struct raster_face *faces    = worker->faces->items;
+
+        pthread_join(worker->thread, NULL);
+        for (size_t j = 0; j < worker->faces->size; ++j)
+            FT_Done_Face(faces[j].face);
+        vector_delete(worker->faces);
+        free(worker->scratch.buffer);
+        FT_Done_FreeType(worker->library);
+    }
+    while (raster.queued)
+    {
+        struct raster_job *next = raster.queued->next;
+        raster_free_job(raster.queued);
+        raster.queued = next;
+    }
+    while (raster.finished)
+    {
+        struct raster_job *next = raster.finished->next;
+        raster_free_job(raster.finished);
+        raster.finished = next;
+    }
+    pthread_cond_destroy(&raster.start);
+    pthread_cond_destroy(&raster.idle);
+    free(raster.workers);
+    raster.workers       = NULL;
+    raster.threads       = 0;
+    raster.queued_tail   = NULL;
+    raster.finished_tail = NULL;
+}
+
+int raster_request(texture_font_t *font, internal_atlas_set_t *atlases,
+                   uint32_t codepoint, rendermode_t rendermode,
+                   float outline_thickness)
+{
+    size_t bucket = raster_bucket(font, codepoint);
+    struct raster_job *job;
+
+    pthread_mutex_lock(&raster.lock);
+    for (job = raster.pending[bucket]; job; job = job->bucket_next)
+    {
+        if (raster_job_matches(job, font, codepoint, rendermode,
+                               outline_thickness))
+        {
+            pthread_mutex_unlock(&raster.lock);
+            return 0;
+        }
+    }
+
+    job = calloc(1, sizeof(*job));
+    if (job == NULL)
+    {
+        pthread_mutex_unlock(&raster.lock);
+        return 0;
+    }
+    job->font              = font;
+    job->atlases           = atlases;
+    job->codepoint         = codepoint;
+    job->rendermode        = rendermode;
+    job->outline_thickness = outline_thickness;
+    job->bucket_next       = raster.pending[bucket];
+    raster.pending[bucket] = job;
+    raster.pending_count++;
+
+    if (raster.queued_tail)
+        raster.queued_tail->next = job;
+    else
+        raster.queued = job;
+    raster.queued_tail = job;
+    pthread_cond_signal(&raster.start);
+    pthread_mutex_unlock(&raster.lock);
+    return 1;
+}
+
+void raster_commit()
+{
+    size_t bytes    = 0;
+    unsigned glyphs = 0;
+
+    if (raster.threads == 0)
+        return;
+
+    double start = trace_begin();
+    pthread_mutex_lock(&raster.lock);
+    /* At least one glyph per frame, however large */
+    while (raster.finished && (raster.budget == 0 || bytes < raster.budget))
+    {
+        struct raster_job *job = raster.finished;
+
+        raster.finished = job->next;
+        if (raster.finished == NULL)
+            raster.finished_tail = NULL;
+        if (job->rendered &&
+            internal_font_commit_glyph(job->font, job->atlases,
+                                       &job->bitmap) ==
+                INTERNAL_GLYPH_COMMITTED)
+        {
+            bytes += job->bitmap.width * job->bitmap.height *
+                     job->font->atlas->depth;
+            glyphs++;
+        }
+        raster_free_job(job);
+    }
+    STATS_ADD(glyphs_rasterized, glyphs);
+    pthread_mutex_unlock(&raster.lock);
+    if (glyphs)
+        trace_complete("glyph commit", start, "glyphs", glyphs, NULL, NULL);
+}
+
+void raster_forget_font(const texture_font_t *font)
+{
+    struct raster_job **link;
+
+    if (raster.threads == 0)
+        return;
+
+    pthread_mutex_lock(&raster.lock);
+    for (int i = 0; i < raster.threads; ++i)
+    {
+        while (raster.workers[i].current &&
+               raster.workers[i].current->font == font)
+            pthread_cond_wait(&raster.idle, &raster.lock);
+    }
+
+    raster.queued_tail = NULL;
+    for (link = &raster.queued; *link;)
+    {
+        struct raster_job *job = *link;
+
+        if (job->font == font)
+        {
+            *link = job->next;
+            raster_free_job(job);
+            continue;
+        }
+        raster.queued_tail = job;
+        link               = &job->next;
+    }
+    raster.finished_tail = NULL;
+    for (link = &raster.finished; *link;)
+    {
+        struct raster_job *job = *link;
+
+        if (job->font == font)
+        {
+            *link = job->next;
+            raster_free_job(job);
+            continue;
+        }
+        raster.finished_tail = job;
+        link                 = &job->next;
+    }
+
+    for (int i = 0; i < raster.threads; ++i)
+    {
+        vector_t *faces           = raster.workers[i].faces;
+        struct raster_face *items = faces->items;
+
+        for (size_t j = 0; j < faces->size; ++j)
+        {
+            if (items[j].font != font)
+                continue;
+            FT_Done_Face(items[j].face);
+            vector_erase(faces, j);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&raster.lock);
+}
@@ -0,0 +1,491 @@
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include "internal/software.h"
+#include "internal/program.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define SOFTWARE_MAX_THREADS 16
+
+struct software_state software;
+
+/* round(x / 255) for x <= 255 * 255 */
+static inline unsigned software_div255(unsigned x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline unsigned char software_unorm8(float value)
+{
+    if (value <= 0.0f)
+        return 0;
+    if (value >= 1.0f)
+        return 255;
+    return (unsigned char) (value * 255.0f + 0.5f);
+}
+
+static inline void software_blend(unsigned char *pixel, unsigned r, unsigned g,
+                                  unsigned b, unsigned a)
+{
+    unsigned inverse = 255 - a;
+
+    pixel[0] = software_div255(r * a) + software_div255(pixel[0] * inverse);
+    pixel[1] = software_div255(g * a) + software_div255(pixel[1] * inverse);
+    pixel[2] = software_div255(b * a) + software_div255(pixel[2] * inverse);
+    pixel[3] = software_div255(a * a) + software_div255(pixel[3] * inverse);
+}
+
+/* Blends a constant color over pixels [x0, x1) of a row */
+static void software_fill_span(unsigned char *row, int x0, int x1,
+                               struct vertex_color color)
+{
+    unsigned a = color.a;
+    int x      = x0;
+
+#ifdef __SSE2__
+    const __m128i zero    = _mm_setzero_si128();
+    const __m128i inverse = _mm_set1_epi16(255 - a);
+    const __m128i bias    = _mm_set1_epi16(128);
+    const __m128i source  = _mm_set_epi16(
+        software_div255(a * a), software_div255(color.b * a),
+        software_div255(color.g * a), software_div255(color.r * a),
+        software_div255(a * a), software_div255(color.b * a),
+        software_div255(color.g * a), software_div255(color.r * a));
+
+    for (; x + 4 <= x1; x += 4)
+    {
+        __m128i *pixels = (__m128i *) (row + x * 4);
+        __m128i dst     = _mm_loadu_si128(pixels);
+        __m128i lo      = _mm_unpacklo_epi8(dst, zero);
+        __m128i hi      = _mm_unpackhi_epi8(dst, zero);
+
+        lo = _mm_add_epi16(_mm_mullo_epi16(lo, inverse), bias);
+        hi = _mm_add_epi16(_mm_mullo_epi16(hi, inverse), bias);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        lo = _mm_add_epi16(lo, source);
+        hi = _mm_add_epi16(hi, source);
+        _mm_storeu_si128(pixels, _mm_packus_epi16(lo, hi));
+    }
+#endif
+
+    for (; x < x1; ++x)
+        software_blend(row + x * 4, color.r, color.g, color.b, a);
+}
+
+static inline void software_texel(const struct draw_image *image, int x, int y,
+                                  float *out)
+{
+    const unsigned char *texel =
+        image->pixels + (y * image->width + x) * image->depth;
+
+    if (image->depth == 1)
+    {
+        /* GL_RED */
+        out[0] = texel[0] / 255.0f;
+        out[1] = 0.0f;
+        out[2] = 0.0f;
+        out[3] = 1.0f;
+        return;
+    }
+    out[0] = texel[0] / 255.0f;
+    out[1] = texel[1] / 255.0f;
+    out[2] = texel[2] / 255.0f;
+    out[3] = texel[3] / 255.0f;
+}
+
+static inline int software_clamp(int value, int max)
+{
+    return value < 0 ? 0 : (value > max ? max : value);
+}
+
+/* Glyph atlases are sampled GL_NEAREST and RGBA textures GL_LINEAR, both
+   GL_CLAMP_TO_EDGE */
+static void software_sample(const struct draw_image *image, float s, float t,
+                            float *out)
+{
+    int w = image->width;
+    int h = image->height;
+
+    if (image->depth == 1)
+    {
+        software_texel(image, software_clamp((int) floorf(s * w), w - 1),
+                       software_clamp((int) floorf(t * h), h - 1), out);
+        return;
+    }
+
+    float u  = s * w - 0.5f;
+    float v  = t * h - 0.5f;
+    float fu = floorf(u);
+    float fv = floorf(v);
+    float ax = u - fu;
+    float ay = v - fv;
+    int x0   = software_clamp((int) fu, w - 1);
+    int x1   = software_clamp((int) fu + 1, w - 1);
+    int y0   = software_clamp((int) fv, h - 1);
+    int y1   = software_clamp((int) fv + 1, h - 1);
+    float t00[4], t10[4], t01[4], t11[4];
+
+    software_texel(image, x0, y0, t00);
+    software_texel(image, x1, y0, t10);
+    software_texel(image, x0, y1, t01);
+    software_texel(image, x1, y1, t11);
+    for (int i = 0; i < 4; ++i)
+    {
+        float top    = t00[i] + (t10[i] - t00[i]) * ax;
+        float bottom = t01[i] + (t11[i] - t01[i]) * ax;
+        out[i]       = top + (bottom - top) * ay;
+    }
+}
+
+/* E(x, y) = a * x + b * y + c, positive inside the triangle. Vertices are
+   snapped to 1/256 of a pixel like GL rasterizers do, which keeps E exact
+   in doubles so ties on shared edges are resolved the same way. */
+struct software_edge
+{
+    double a;
+    double b;
+    double c;
+    int inclusive;
+};
+
+static inline float software_snap(float value)
+{
+    return roundf(value * 256.0f) / 256.0f;
+}
+
+/* Pixels exactly on an edge belong to the triangle where a > 0, or a == 0
+   and b < 0: GL's top-left rule, with window y pointing up. Shared edges
+   are drawn once. */
+static void software_edge_setup(struct software_edge *edge, const vec2 *from,
+                                const vec2 *to)
+{
+    double dx = to->x - from->x;
+    double dy = to->y - from->y;
+
+    edge->a         = -dy;
+    edge->b         = dx;
+    edge->c         = dy * from->x - dx * from->y;
+    edge->inclusive = edge->a > 0.0 || (edge->a == 0.0 && edge->b < 0.0);
+}
+
+static inline int software_edge_inside(const struct software_edge *edge,
+                                       int x, double r)
+{
+    double e = edge->a * (x + 0.5) + r;
+
+    return e > 0.0 || (e == 0.0 && edge->inclusive);
+}
+
+/* Narrows [x0, x1) to the pixels of row y inside the edge */
+static int software_edge_row(const struct software_edge *edge, double y,
+                             int *x0, int *x1)
+{
+    double r = edge->b * y + edge->c;
+
+    if (edge->a == 0.0)
+        return r > 0.0 || (r == 0.0 && edge->inclusive);
+
+    /* The division only gives a first guess, E decides */
+    int x = (int) ceil(-r / edge->a - 0.5);
+    if (edge->a > 0.0)
+    {
+        while (software_edge_inside(edge, x - 1, r))
+            --x;
+        while (!software_edge_inside(edge, x, r))
+            ++x;
+        if (x > *x0)
+            *x0 = x;
+    }
+    else
+    {
+        while (!software_edge_inside(edge, x - 1, r))
+            --x;
+        while (software_edge_inside(edge, x, r))
+            ++x;
+        if (x < *x1)
+            *x1 = x;
+    }
+    return 1;
+}
+
+static void software_triangle(const struct vertex_main *v0,
+                              const struct vertex_main *v1,
+                              const struct vertex_main *v2, int band_y0,
+                              int band_y1)
+{
+    const struct vertex_main *p[3] = { v0, v1, v2 };
+    struct software_edge edges[3];
+    vec2 position[3];
+    double area;
+
+    /* Flat attributes come from the last vertex, as in GL */
+    int mode = v2->mode;
+    const struct draw_image *image = &software.images[v2->slot];
+
+    for (int i = 0; i < 3; ++i)
+    {
+        position[i].x = software_snap(p[i]->position.x + software.offset.x);
+        position[i].y = software_snap(p[i]->position.y + software.offset.y);
+    }
+    area = ((double) position[1].x - position[0].x) *
+               ((double) position[2].y - position[0].y) -
+           ((double) position[1].y - position[0].y) *
+               ((double) position[2].x - position[0].x);
+    if (area == 0.0)
+        return;
+    if (area < 0.0)
+    {
+        vec2 swap   = position[1];
+        position[1] = position[2];
+        position[2] = swap;
+        p[1]        = v2;
+        p[2]        = v1;
+        area        = -area;
+    }
+
+    software_edge_setup(&edges[0], &position[1], &position[2]);
+    software_edge_setup(&edges[1], &position[2], &position[0]);
+    software_edge_setup(&edges[2], &position[0], &position[1]);
+
+    float min_x = fminf(position[0].x, fminf(position[1].x, position[2].x));
+    float max_x = fmaxf(position[0].x, fmaxf(position[1].x, position[2].x));
+    float min_y = fminf(position[0].y, fminf(position[1].y, position[2].y));
+    float max_y = fmaxf(position[0].y, fmaxf(position[1].y, position[2].y));
+
+    int y0  = (int) floorf(min_y);
+    int y1  = (int) ceilf(max_y);
+    int bx0 = (int) floorf(min_x);
+    int bx1 = (int) ceilf(max_x);
+    if (y0 < band_y0)
+        y0 = band_y0;
+    if (y1 > band_y1)
+        y1 = band_y1;
+    if (bx0 < 0)
+        bx0 = 0;
+    if (bx1 > software.width)
+        bx1 = software.width;
+    if (y0 >= y1 || bx0 >= bx1)
+        return;
+
+    int constant = mode == DRAW_MODE_PLAIN &&
+                   !memcmp(&v0->color, &v1->color, sizeof(v0->color)) &&
+                   !memcmp(&v0->color, &v2->color, sizeof(v0->color));
+    double inverse_area = 1.0 / area;
+
+    for (int y = y0; y < y1; ++y)
+    {
+        double cy = y + 0.5;
+        int x0    = bx0;
+        int x1   = bx1;
+
+        if (!software_edge_row(&edges[0], cy, &x0, &x1) ||
+            !software_edge_row(&edges[1], cy, &x0, &x1) ||
+            !software_edge_row(&edges[2], cy, &x0, &x1) || x0 >= x1)
+            continue;
+
+        unsigned char *row = software.target + (size_t) y * software.stride;
+        if (constant)
+        {
+            software_fill_span(row, x0, x1, v2->color);
+            continue;
+        }
+
+        /* Barycentric weights at the first pixel center, then stepped */
+        float l[3];
+        float step[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            l[i] = (edges[i].a * (x0 + 0.5) + edges[i].b * cy + edges[i].c) *
+                   inverse_area;
+            step[i] = edges[i].a * inverse_area;
+        }
+
+        for (int x = x0; x < x1;
+             ++x, l[0] += step[0], l[1] += step[1], l[2] += step[2])
+        {
+            float color[4];
+            float tex[4];
+
+            color[0] = (l[0] * p[0]->color.r + l[1] * p[1]->color.r +
+                        l[2] * p[2]->color.r) / 255.0f;
+            color[1] = (l[0] * p[0]->color.g + l[1] * p[1]->color.g +
+                        l[2] * p[2]->color.g) / 255.0f;
+            color[2] = (l[0] * p[0]->color.b + l[1] * p[1]->color.b +
+                        l[2] * p[2]->color.b) / 255.0f;
+            color[3] = (l[0] * p[0]->color.a + l[1] * p[1]->color.a +
+                        l[2] * p[2]->color.a) / 255.0f;
+
+            if (mode != DRAW_MODE_PLAIN)
+            {
+                float s = (l[0] * p[0]->tex_coords.x + l[1] * p[1]->tex_coords.x +
+                           l[2] * p[2]->tex_coords.x) / 65535.0f;
+                float t = (l[0] * p[0]->tex_coords.y + l[1] * p[1]->tex_coords.y +
+                           l[2] * p[2]->tex_coords.y) / 65535.0f;
+
+                software_sample(image, s, t, tex);
+                if (mode == DRAW_MODE_TEXTURED)
+                {
+                    for (int i = 0; i < 4; ++i)
+                        color[i] *= tex[i];
+                }
+                else if (mode == DRAW_MODE_FREETYPE)
+                    color[3] *= tex[0];
+                else
+                {
+                    color[0] = color[1] = color[2] = 0.0f;
+                    color[3] = 1.0f;
+                }
+            }
+
+            software_blend(row + x * 4, software_unorm8(color[0]),
+                           software_unorm8(color[1]), software_unorm8(color[2]),
+                           software_unorm8(color[3]));
+        }
+    }
+}
+
+static void software_band(int index)
+{
+    int y0 = software.height * index / software.threads;
+    int y1 = software.height * (index + 1) / software.threads;
+
+    for (size_t i = 0; i < software.quads; ++i)
+    {
+        const struct vertex_main *quad = software.vertices + i * 4;
+
+        software_triangle(&quad[0], &quad[1], &quad[2], y0, y1);
+        software_triangle(&quad[2], &quad[3], &quad[0], y0, y1);
+    }
+}
+
+static void *software_worker(void *argument)
+{
+    int index     = (int) (intptr_t) argument;
+    unsigned seen = 0;
+
+    pthread_mutex_lock(&software.lock);
+    for (;;)
+    {
+        while (software.generation == seen && !software.shutdown)
+            pthread_cond_wait(&software.start, &software.lock);
+        if (software.shutdown)
+            break;
+        seen = software.generation;
+        pthread_mutex_unlock(&software.lock);
+
+        software_band(index);
+
+        pthread_mutex_lock(&software.lock);
+        if (--software.pending == 0)
+            pthread_cond_signal(&software.done);
+    }
+    pthread_mutex_unlock(&software.lock);
+    return NULL;
+}
+
+void software_init(int width, int height, const glez_options_t *options)
+{
+    memset(&software, 0, sizeof(software));
+    software.enabled = 1;
+    software.target  = options->software_target;
+    software.stride  = options->software_stride;
+    software.width   = width;
+    software.height  = height;
+
+    software.threads = options->software_threads;
+    if (software.threads <= 0)
+        software.threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (software.threads <= 0)
+        software.threads = 1;
+    if (software.threads > SOFTWARE_MAX_THREADS)
+        software.threads = SOFTWARE_MAX_THREADS;
+
+    pthread_mutex_init(&software.lock, NULL);
+    pthread_cond_init(&software.start, NULL);
+    pthread_cond_init(&software.done, NULL);
+    software.workers = calloc(software.threads, sizeof(pthread_t));
+    for (int i = 1; i < software.threads; ++i)
+    {
+        if (pthread_create(&software.workers[i], NULL, software_worker,
+                           (void *) (intptr_t) i) != 0)
+        {
+            /* Run with the threads that did start */
+            software.threads = i;
+            break;
+        }
+    }
+}
+
+void software_destroy()
+{
+    if (!software.enabled)
+        return;
+
+    pthread_mutex_lock(&software.lock);
+    software.shutdown = 1;
+    pthread_cond_broadcast(&software.start);
+    pthread_mutex_unlock(&software.lock);
+    for (int i = 1; i < software.threads; ++i)
+        pthread_join(software.workers[i], NULL);
+    free(software.workers);
+
+    pthread_cond_destroy(&software.done);
+    pthread_cond_destroy(&software.start);
+    pthread_mutex_destroy(&software.lock);
+    memset(&software, 0, sizeof(software));
+}
+
+void software_resize(int width, int height)
+{
+    software.width  = width;
+    software.height = height;
+}
+
+void software_draw(const struct vertex_main *vertices, size_t quads,
+                   const struct draw_image *images, float dx, float dy)
+{
+    if (software.target == NULL || quads == 0)
+        return;
+
+    software.vertices = vertices;
+    software.quads    = quads;
+    software.images   = images;
+    software.offset.x = dx;
+    software.offset.y = dy;
+
+    if (software.threads == 1)
+    {
+        software_band(0);
+        return;
+    }
+
+    pthread_mutex_lock(&software.lock);
+    software.pending = software.threads - 1;
+    software.generation++;
+    pthread_cond_broadcast(&software.start);
+    pthread_mutex_unlock(&software.lock);
+
+    software_band(0);
+
+    pthread_mutex_lock(&software.lock);
+    while (software.pending)
+        pthread_cond_wait(&software.done, &software.lock);
+    pthread_mutex_unlock(&software.lock);
+}
+
+void glez_software_target(void *pixels, int stride)
+{
+    software.target = pixels;
+    software.stride = stride;
+}
@@ -0,0 +1,45 @@
+#include "glez.h"
+
+#include "internal/stats.h"
+
+#include <string.h>
+#include <time.h>
+
+struct stats_state stats;
+
+double stats_now()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+void stats_init()
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+void stats_begin_frame()
+{
+#ifndef GLEZ_NO_STATS
+    memset(&stats.frame, 0, sizeof(stats.frame));
+#endif
+}
+
+void stats_end_frame()
+{
+#ifndef GLEZ_NO_STATS
+    memcpy(&stats.last, &stats.frame, sizeof(stats.last));
+#endif
+}
+
+void glez_get_frame_stats(glez_frame_stats_t *out)
+{
+    memcpy(out, &stats.last, sizeof(*out));
+}
+
+void glez_get_init_stats(glez_init_stats_t *out)
+{
+    memcpy(out, &stats.init, sizeof(*out));
+}
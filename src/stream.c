@@ -0,0 +1,179 @@
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include "internal/stream.h"
+#include "internal/trace.h"
+
+#include <string.h>
+
+struct stream_state stream;
+
+static const GLbitfield stream_persistent_flags =
+    GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+static void stream_create()
+{
+    size_t size = stream.segment_size * STREAM_SEGMENTS;
+
+    glGenBuffers(1, &stream.buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+    if (stream.mode == STREAM_PERSISTENT)
+    {
+        glBufferStorage(GL_ARRAY_BUFFER, size, NULL, stream_persistent_flags);
+        stream.mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, size,
+                                         stream_persistent_flags);
+        if (stream.mapped == NULL)
+        {
+            /* Storage is immutable, start over with a mutable buffer */
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glDeleteBuffers(1, &stream.buffer);
+            stream.mode = STREAM_MAP_RANGE;
+            stream_create();
+            return;
+        }
+    }
+    else
+        glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    stream.start  = 0;
+    stream.end    = 0;
+    stream.offset = 0;
+}
+
+static void stream_release()
+{
+    for (int i = 0; i < STREAM_SEGMENTS; ++i)
+    {
+        if (stream.fences[i])
+            glDeleteSync(stream.fences[i]);
+        stream.fences[i] = 0;
+    }
+    if (stream.mapped)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        stream.mapped = NULL;
+    }
+    if (stream.buffer)
+        glDeleteBuffers(1, &stream.buffer);
+    stream.buffer = 0;
+}
+
+void stream_init(size_t segment_size, int ring)
+{
+    memset(&stream, 0, sizeof(stream));
+
+    if (!ring || (!GLEW_VERSION_3_2 && !GLEW_ARB_draw_elements_base_vertex))
+        stream.mode = STREAM_BUFFER_DATA;
+    else if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+        stream.mode = STREAM_PERSISTENT;
+    else if (GLEW_VERSION_3_0 || GLEW_ARB_map_buffer_range)
+        stream.mode = STREAM_MAP_RANGE;
+    else
+        stream.mode = STREAM_BUFFER_DATA;
+
+    stream.segment_size = segment_size;
+    stream_create();
+}
+
+void stream_destroy()
+{
+    stream_release();
+    stream.mode = STREAM_NONE;
+}
+
+void stream_begin_frame()
+{
+    GLsync fence;
+
+    if (stream.mode != STREAM_PERSISTENT)
+        return;
+
+    stream.segment = (stream.segment + 1) % STREAM_SEGMENTS;
+    stream.start   = 0;
+    stream.end     = 0;
+
+    fence = stream.fences[stream.segment];
+    if (fence == 0)
+        return;
+    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) ==
+           GL_TIMEOUT_EXPIRED)
+        ;
+    glDeleteSync(fence);
+    stream.fences[stream.segment] = 0;
+}
+
+void stream_end_frame()
+{
+    if (stream.mode != STREAM_PERSISTENT)
+        return;
+
+    if (stream.fences[stream.segment])
+        glDeleteSync(stream.fences[stream.segment]);
+    stream.fences[stream.segment] =
+        glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+int stream_fits(size_t bytes)
+{
+    return stream.end + bytes <= stream.segment_size;
+}
+
+void stream_grow(size_t bytes)
+{
+    /* The old buffer stays alive in the driver until draws reading it are
+       done, and nothing has touched the new one yet: no fences to keep */
+    stream_release();
+    do
+        stream.segment_size *= 2;
+    while (stream.segment_size < bytes);
+    stream_create();
+}
+
+void *stream_alloc(size_t bytes)
+{
+    void *result =
+        stream.mapped + stream.segment * stream.segment_size + stream.end;
+    stream.end += bytes;
+    return result;
+}
+
+size_t stream_upload(const void *data, size_t bytes)
+{
+    size_t size  = stream.segment_size * STREAM_SEGMENTS;
+    double start = trace_begin();
+    size_t result;
+    void *dst;
+
+    glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+    if (stream.mode == STREAM_BUFFER_DATA)
+    {
+        glBufferData(GL_ARRAY_BUFFER, bytes, data, GL_STREAM_DRAW);
+        trace_complete("vertex upload", start, "bytes", bytes, NULL, NULL);
+        return 0;
+    }
+
+    if (stream.offset + bytes > size)
+    {
+        /* Orphan the storage: the driver hands out a fresh block while
+           queued draws keep reading the old one */
+        while (stream.segment_size * STREAM_SEGMENTS < bytes)
+            stream.segment_size *= 2;
+        size = stream.segment_size * STREAM_SEGMENTS;
+        glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+        stream.offset = 0;
+    }
+
+    dst = glMapBufferRange(GL_ARRAY_BUFFER, stream.offset, bytes,
+                           GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                               GL_MAP_UNSYNCHRONIZED_BIT);
+    memcpy(dst, data, bytes);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+
+    result = stream.offset;
+    stream.offset += bytes;
+    trace_complete("vertex upload", start, "bytes", bytes, NULL, NULL);
+    return result;
+}
@@ -9,8 +9,12 @@
 #include <GL/gl.h>
 
 #include "glez.h"
+#include "internal/capture.h"
 #include "internal/draw.h"
+#include "internal/list.h"
+#include "internal/software.h"
 #include "internal/textures.h"
+#include "internal/trace.h"
 
 #include <assert.h>
 #include <string.h>
@@ -30,6 +34,18 @@ void internal_textures_destroy()
 {
 }
 
+void internal_textures_capture()
+{
+    for (glez_texture_t i = 0; i < GLEZ_TEXTURE_COUNT; ++i)
+    {
+        if (!loaded_textures[i].init)
+            continue;
+        struct capture_handle record = { i };
+        capture_write(CAPTURE_OP_TEXTURE, &record, sizeof(record),
+                      loaded_textures[i].filename);
+    }
+}
+
 int internal_texture_load_png_rgba(const char *name, internal_texture_t *out)
 {
     memset(out, 0, sizeof(internal_texture_t));
@@ -120,22 +136,34 @@ internal_texture_t *internal_texture_get(glez_texture_t handle)
 void internal_texture_bind(glez_texture_t handle)
 {
     internal_texture_t *texture = internal_texture_get(handle);
+    struct draw_image image     = { texture->data, texture->width,
+                                    texture->height, 4 };
+
+    if (software.enabled)
+    {
+        ds_bind_texture(0, &image);
+        return;
+    }
 
     if (!texture->bound)
     {
+        struct draw_unpack unpack;
+
         glGenTextures(1, &texture->texture_id);
-        glBindTexture(GL_TEXTURE_2D, texture->texture_id);
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        ds_bind_texture(texture->texture_id, &image);
+        ds_unpack_begin(&unpack);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture->width, texture->height,
                      0, GL_RGBA, GL_UNSIGNED_BYTE, texture->data);
+        ds_unpack_end(&unpack);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         texture->bound = 1;
+        return;
     }
 
-    ds_bind_texture(texture->texture_id);
+    ds_bind_texture(texture->texture_id, &image);
 }
 
 glez_texture_t glez_texture_load_png_rgba(const char *path)
@@ -143,12 +171,16 @@ glez_texture_t glez_texture_load_png_rgba(const char *path)
     internal_texture_t result;
 
     memset(&result, 0, sizeof(result));
-    strncpy(result.filename, path, 255);
 
+    double start = trace_begin();
     if (internal_texture_load_png_rgba(path, &result) != 0)
     {
         return GLEZ_TEXTURE_INVALID;
     }
+    trace_complete("png decode", start, "bytes",
+                   (long) result.width * result.height * 4, "file", path);
+    /* After loading, which clears result */
+    strncpy(result.filename, path, 255);
 
     for (glez_texture_t i = 0; i < GLEZ_TEXTURE_COUNT; ++i)
     {
@@ -156,6 +188,12 @@ glez_texture_t glez_texture_load_png_rgba(const char *path)
         {
             memcpy(&loaded_textures[i], &result, sizeof(result));
             loaded_textures[i].init = 1;
+            if (capture.file)
+            {
+                struct capture_handle record = { i };
+                capture_write(CAPTURE_OP_TEXTURE, &record, sizeof(record),
+                              path);
+            }
             return i;
         }
     }
@@ -167,10 +205,18 @@ void glez_texture_unload(glez_texture_t handle)
 {
     internal_texture_t *tx = internal_texture_get(handle);
 
-    glDeleteTextures(1, &tx->texture_id);
+    if (tx->texture_id)
+        glDeleteTextures(1, &tx->texture_id);
     free(tx->data);
 
     tx->init = 0;
+    list_texture_unloaded(handle);
+    if (capture.file)
+    {
+        struct capture_handle record = { handle };
+        capture_write(CAPTURE_OP_TEXTURE_UNLOAD, &record, sizeof(record),
+                      NULL);
+    }
 }
 
 void glez_texture_size(glez_texture_t handle, int *width, int *height)
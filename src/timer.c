@@ -0,0 +1,150 @@
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include "internal/timer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct timer_state timer;
+
+void timer_init(const glez_options_t *options)
+{
+    memset(&timer, 0, sizeof(timer));
+
+    if (options->gpu_timing == GLEZ_GPU_TIMING_OFF ||
+        options->profile == GLEZ_PROFILE_ES)
+        return;
+    if (!GLEW_VERSION_3_3 && !GLEW_ARB_timer_query)
+        return;
+    timer.mode = options->gpu_timing;
+}
+
+void timer_destroy()
+{
+    for (int i = 0; i < TIMER_LATENCY; ++i)
+    {
+        struct timer_frame *frame = &timer.frames[i];
+        if (frame->capacity)
+            glDeleteQueries(frame->capacity, frame->queries);
+        free(frame->queries);
+    }
+    memset(&timer, 0, sizeof(timer));
+}
+
+static void timer_push_sample(double ms)
+{
+    timer.samples[timer.next_sample] = ms;
+    timer.next_sample = (timer.next_sample + 1) % GLEZ_GPU_TIMING_WINDOW;
+    if (timer.sample_count < GLEZ_GPU_TIMING_WINDOW)
+        timer.sample_count++;
+    timer.last_ms = ms;
+}
+
+static void timer_collect(struct timer_frame *frame)
+{
+    GLint available = 0;
+    GLuint64 elapsed;
+    GLuint64 total = 0;
+
+    if (frame->count == 0)
+        return;
+
+    /* Queries complete in order, the last one being ready means all are.
+       Never wait: a frame that is still in flight is dropped. */
+    glGetQueryObjectiv(frame->queries[frame->count - 1],
+                       GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+    {
+        timer.dropped++;
+        return;
+    }
+
+    for (int i = 0; i < frame->count; ++i)
+    {
+        glGetQueryObjectui64v(frame->queries[i], GL_QUERY_RESULT, &elapsed);
+        total += elapsed;
+    }
+    timer_push_sample(total / 1000000.0);
+}
+
+static void timer_begin_query()
+{
+    struct timer_frame *frame = &timer.frames[timer.frame];
+
+    if (frame->count == frame->capacity)
+    {
+        int capacity = frame->capacity ? frame->capacity * 2 : 4;
+        frame->queries =
+            realloc(frame->queries, capacity * sizeof(*frame->queries));
+        glGenQueries(capacity - frame->capacity,
+                     frame->queries + frame->capacity);
+        frame->capacity = capacity;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, frame->queries[frame->count++]);
+}
+
+void timer_begin_frame()
+{
+    struct timer_frame *frame;
+
+    if (timer.mode == GLEZ_GPU_TIMING_OFF)
+        return;
+
+    timer.frame = (timer.frame + 1) % TIMER_LATENCY;
+    frame       = &timer.frames[timer.frame];
+    timer_collect(frame);
+    frame->count = 0;
+
+    if (timer.mode == GLEZ_GPU_TIMING_FRAME)
+        timer_begin_query();
+}
+
+void timer_end_frame()
+{
+    if (timer.mode == GLEZ_GPU_TIMING_FRAME)
+        glEndQuery(GL_TIME_ELAPSED);
+}
+
+void timer_begin_flush()
+{
+    if (timer.mode == GLEZ_GPU_TIMING_FLUSH)
+        timer_begin_query();
+}
+
+void timer_end_flush()
+{
+    if (timer.mode == GLEZ_GPU_TIMING_FLUSH)
+        glEndQuery(GL_TIME_ELAPSED);
+}
+
+static int timer_compare(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+void glez_get_gpu_stats(glez_gpu_stats_t *out)
+{
+    double sorted[GLEZ_GPU_TIMING_WINDOW];
+    double total = 0;
+    unsigned count = timer.sample_count;
+
+    memset(out, 0, sizeof(*out));
+    out->dropped = timer.dropped;
+    if (count == 0)
+        return;
+
+    memcpy(sorted, timer.samples, count * sizeof(double));
+    qsort(sorted, count, sizeof(double), timer_compare);
+    for (unsigned i = 0; i < count; ++i)
+        total += sorted[i];
+
+    out->samples = count;
+    out->last_ms = timer.last_ms;
+    out->min_ms  = sorted[0];
+    out->avg_ms  = total / count;
+    out->p99_ms  = sorted[(count * 99 + 99) / 100 - 1];
+}
@@ -0,0 +1,144 @@
+#include "glez.h"
+
+#include "internal/trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define TRACE_DEFAULT_EVENTS 65536
+
+struct trace_state trace = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static __thread long trace_tid;
+
+void trace_complete(const char *name, double start, const char *arg_name,
+                    long arg, const char *text_name, const char *text)
+{
+    double end = stats_now();
+
+    if (start == 0.0)
+        return;
+    if (trace_tid == 0)
+        trace_tid = syscall(SYS_gettid);
+
+    pthread_mutex_lock(&trace.lock);
+    if (trace.events)
+    {
+        struct trace_event *event =
+            &trace.events[trace.total++ % trace.capacity];
+
+        event->name      = name;
+        event->arg_name  = arg_name;
+        event->text_name = text_name;
+        event->start     = start;
+        event->duration  = end - start;
+        event->tid       = trace_tid;
+        event->arg       = arg;
+        event->text[0]   = 0;
+        if (text_name)
+        {
+            /* Keep the end, where file names are */
+            size_t length = strlen(text);
+            if (length >= TRACE_TEXT_SIZE)
+                text += length - (TRACE_TEXT_SIZE - 1);
+            strcpy(event->text, text);
+        }
+    }
+    pthread_mutex_unlock(&trace.lock);
+}
+
+int glez_trace_start(unsigned events)
+{
+    struct trace_event *ring;
+
+    if (events == 0)
+        events = TRACE_DEFAULT_EVENTS;
+    ring = calloc(events, sizeof(struct trace_event));
+    if (ring == NULL)
+        return -1;
+
+    pthread_mutex_lock(&trace.lock);
+    free(trace.events);
+    trace.events   = ring;
+    trace.capacity = events;
+    trace.total    = 0;
+    pthread_mutex_unlock(&trace.lock);
+    return 0;
+}
+
+void glez_trace_stop()
+{
+    pthread_mutex_lock(&trace.lock);
+    free(trace.events);
+    trace.events   = NULL;
+    trace.capacity = 0;
+    trace.total    = 0;
+    pthread_mutex_unlock(&trace.lock);
+}
+
+static void trace_write_string(FILE *file, const char *string)
+{
+    fputc('"', file);
+    for (; *string; ++string)
+    {
+        unsigned char c = *string;
+
+        if (c == '"' || c == '\\')
+            fprintf(file, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(file, "\\u%04x", c);
+        else
+            fputc(c, file);
+    }
+    fputc('"', file);
+}
+
+int glez_trace_write(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    int pid    = getpid();
+    int result = 0;
+
+    if (file == NULL)
+    {
+        perror("glez: could not open trace file");
+        return -1;
+    }
+
+    pthread_mutex_lock(&trace.lock);
+    unsigned long first =
+        trace.total > trace.capacity ? trace.total - trace.capacity : 0;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (unsigned long i = first; i < trace.total; ++i)
+    {
+        const struct trace_event *event = &trace.events[i % trace.capacity];
+
+        /* Microseconds of CLOCK_MONOTONIC, like other Linux trace sources */
+        fprintf(file,
+                "%s\n{\"name\":\"%s\",\"cat\":\"glez\",\"ph\":\"X\","
+                "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%ld,\"args\":{",
+                i == first ? "" : ",", event->name, event->start * 1e6,
+                event->duration * 1e6, pid, event->tid);
+        if (event->arg_name)
+            fprintf(file, "\"%s\":%ld", event->arg_name, event->arg);
+        if (event->text_name)
+        {
+            fprintf(file, "%s\"%s\":", event->arg_name ? "," : "",
+                    event->text_name);
+            trace_write_string(file, event->text);
+        }
+        fprintf(file, "}}");
+    }
+    fprintf(file, "\n]}\n");
+    pthread_mutex_unlock(&trace.lock);
+
+    if (ferror(file))
+        result = -1;
+    if (fclose(file) != 0)
+        result = -1;
+    return result;
+}
@@ -0,0 +1,705 @@
+/* Regression tests: draws the scripted scenes headless, compares the
+   readbacks with the golden images and checks the glez counters.
+
+   glez-test [-u] [-f fonts] [-d dir] [-o failed] [test...]
+
+   -u  writes the golden images of the "gl" test instead of comparing
+   -f  directory of the DejaVu fonts, /usr/share/fonts/truetype/dejavu by
+       default
+   -d  directory holding golden/ and data/, "tests" by default
+   -o  directory where the images of failed comparisons are written
+
+   The "capture" test runs the glez-replay next to glez-test.
+
+   Tests named on the command line run alone. Golden images depend on
+   the FreeType and Mesa versions: after an upgrade, check the "gl"
+   output by eye and rewrite them with -u. */
+
+#include <GL/glew.h>
+
+#include "glez.h"
+#include "headless.h"
+#include "image.h"
+#include "scenes.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Small, so the golden images stay small */
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 240
+
+enum
+{
+    TEST_PASS = 0,
+    TEST_FAIL,
+    TEST_SKIP
+};
+
+struct test
+{
+    const char *name;
+    int (*run)();
+};
+
+static struct
+{
+    int update;
+    const char *font_dir;
+    const char *dir;
+    const char *failed_dir;
+    char replay[1024];
+
+    int software;
+    unsigned char *pixels;
+    struct scene_resources resources;
+} test = { 0, "/usr/share/fonts/truetype/dejavu", "tests", NULL };
+
+/* Background of every frame, exact in RGBA8 */
+static const unsigned char test_clear[4] = { 26, 51, 77, 255 };
+
+/* Creates the context for options and loads the scene resources. Returns
+   TEST_PASS, or TEST_SKIP when the context is not available. */
+static int test_start(glez_options_t *options)
+{
+    char data_dir[1024];
+
+    test.software = options->backend == GLEZ_BACKEND_SOFTWARE;
+    test.pixels   = malloc(TEST_WIDTH * TEST_HEIGHT * 4);
+    if (test.software)
+    {
+        options->software_target = test.pixels;
+        options->software_stride = TEST_WIDTH * 4;
+    }
+    else
+    {
+        if (headless_init(options->profile) != 0)
+        {
+            free(test.pixels);
+            return TEST_SKIP;
+        }
+        headless_resize(TEST_WIDTH, TEST_HEIGHT);
+    }
+    glez_init_ex(TEST_WIDTH, TEST_HEIGHT, options);
+    snprintf(data_dir, sizeof(data_dir), "%s/data", test.dir);
+    if (scene_load(test.font_dir, data_dir, &test.resources) != 0)
+        exit(2);
+    return TEST_PASS;
+}
+
+static void test_finish()
+{
+    scene_unload(&test.resources);
+    glez_shutdown();
+    if (!test.software)
+        headless_destroy();
+    free(test.pixels);
+}
+
+static void test_clear_frame()
+{
+    if (test.software)
+    {
+        for (size_t i = 0; i < TEST_WIDTH * TEST_HEIGHT; ++i)
+            memcpy(test.pixels + i * 4, test_clear, 4);
+        return;
+    }
+    glClearColor(test_clear[0] / 255.0f, test_clear[1] / 255.0f,
+                 test_clear[2] / 255.0f, test_clear[3] / 255.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+static void test_frame(const struct scene *scene, glez_frame_stats_t *stats)
+{
+    test_clear_frame();
+    glez_begin();
+    scene->draw(&test.resources, TEST_WIDTH, TEST_HEIGHT);
+    glez_end();
+    glez_get_frame_stats(stats);
+}
+
+static void test_read(struct image *out)
+{
+    out->width  = TEST_WIDTH;
+    out->height = TEST_HEIGHT;
+    out->pixels = malloc(TEST_WIDTH * TEST_HEIGHT * 4);
+    if (test.software)
+        memcpy(out->pixels, test.pixels, TEST_WIDTH * TEST_HEIGHT * 4);
+    else
+        headless_read(out->pixels);
+}
+
+/* Draws frames of scene until every glyph is in the atlas, and reads the
+   last one */
+static void test_render(const struct scene *scene, struct image *out)
+{
+    glez_frame_stats_t stats;
+
+    for (int frame = 0; frame < 100; ++frame)
+    {
+        test_frame(scene, &stats);
+        if (frame > 0 && stats.glyph_misses == 0 && stats.glyphs_pending == 0)
+            break;
+    }
+    test_read(out);
+}
+
+static void test_write_failed(const char *name, const char *scene,
+                              const struct image *image)
+{
+    char path[1024];
+
+    if (test.failed_dir == NULL)
+        return;
+    snprintf(path, sizeof(path), "%s/%s-%s.png", test.failed_dir, name,
+             scene);
+    image_write_png(path, image);
+}
+
+/* Compares image with the golden image of scene. Pixels with a channel
+   more than tolerance off count as different, and up to allowed of them
+   pass. */
+static int test_golden(const char *name, const char *scene,
+                       const struct image *image, int tolerance,
+                       size_t allowed)
+{
+    struct image golden;
+    char path[1024];
+    size_t differ;
+    int max;
+
+    snprintf(path, sizeof(path), "%s/golden/%s.png", test.dir, scene);
+    if (test.update && strcmp(name, "gl") == 0)
+    {
+        if (image_write_png(path, image) != 0)
+        {
+            printf("FAIL %s/%s: could not write %s\n", name, scene, path);
+            return TEST_FAIL;
+        }
+        printf("wrote %s\n", path);
+        return TEST_PASS;
+    }
+    if (image_read_png(path, &golden) != 0)
+    {
+        printf("FAIL %s/%s: could not read %s\n", name, scene, path);
+        return TEST_FAIL;
+    }
+
+    differ = image_compare(image, &golden, tolerance, &max);
+    image_free(&golden);
+    if (differ > allowed)
+    {
+        printf("FAIL %s/%s: %zu pixels differ by more than %d, up to %d\n",
+               name, scene, differ, tolerance, max);
+        test_write_failed(name, scene, image);
+        return TEST_FAIL;
+    }
+    printf("ok   %s/%s (%zu pixels differ, up to %d)\n", name, scene,
+           differ, max);
+    return TEST_PASS;
+}
+
+/* Every scene with options against its golden image */
+static int test_scenes(const char *name, glez_options_t *options,
+                       int tolerance, size_t allowed)
+{
+    int result = test_start(options);
+
+    if (result != TEST_PASS)
+        return result;
+    for (const struct scene *scene = scenes; scene->name; ++scene)
+    {
+        struct image image;
+
+        test_render(scene, &image);
+        if (test_golden(name, scene->name, &image, tolerance, allowed))
+            result = TEST_FAIL;
+        image_free(&image);
+    }
+    test_finish();
+    return result;
+}
+
+/* The default options, which the golden images are made with */
+static int test_gl()
+{
+    glez_options_t options;
+
+    glez_options_default(&options);
+    return test_scenes("gl", &options, 1, 0);
+}
+
+/* The core and ES profiles must draw what the compatibility profile
+   does */
+static int test_profile(const char *name, int profile)
+{
+    glez_options_t options;
+
+    glez_options_default(&options);
+    options.profile = profile;
+    return test_scenes(name, &options, 1, 0);
+}
+
+static int test_core()
+{
+    return test_profile("core", GLEZ_PROFILE_CORE);
+}
+
+static int test_es()
+{
+    return test_profile("es", GLEZ_PROFILE_ES);
+}
+
+/* The software backend against the GL golden images. Bilinear sampling
+   and blending round a little differently, up to 7 after the 16 layers of
+   the fill scene; a few edge pixels of thin diagonal lines differ more. A
+   wrong fill rule or sampling offset moves whole edges, thousands of
+   pixels. */
+static int test_software()
+{
+    glez_options_t options;
+
+    glez_options_default(&options);
+    options.backend = GLEZ_BACKEND_SOFTWARE;
+    return test_scenes("software", &options, 8, 32);
+}
+
+/* The first frame of the rects scene has more quads than the first stream
+   segment holds, so the vertex buffer is recreated in the middle of it */
+static int test_stream_mode(const char *name, int streaming)
+{
+    const struct scene *scene = scene_find("rects");
+    glez_options_t options;
+    glez_frame_stats_t stats;
+    struct image image;
+    int result;
+
+    glez_options_default(&options);
+    options.streaming = streaming;
+    result            = test_start(&options);
+    if (result != TEST_PASS)
+        return result;
+    test_frame(scene, &stats);
+    test_read(&image);
+    result = test_golden(name, scene->name, &image, 1, 0);
+    image_free(&image);
+    test_finish();
+    return result;
+}
+
+static int test_stream()
+{
+    int result = test_stream_mode("stream-ring", GLEZ_STREAMING_RING);
+
+    if (test_stream_mode("stream-buffer-data", GLEZ_STREAMING_BUFFER_DATA))
+        result = TEST_FAIL;
+    return result;
+}
+
+/* The atlas is uploaded with the host's unpack state set to what would
+   break it, glez restores that state after */
+static int test_atlas_size(const char *name, int page_size)
+{
+    static const char *names[] = { "glyphs", "mixed" };
+    glez_options_t options;
+    GLint alignment, row_length;
+    int result;
+
+    glez_options_default(&options);
+    options.atlas_page_size = page_size;
+    options.state_guard     = GLEZ_STATE_TRUST_HOST;
+    result                  = test_start(&options);
+    if (result != TEST_PASS)
+        return result;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 8);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 3);
+    for (int i = 0; i < 2; ++i)
+    {
+        struct image image;
+
+        test_render(scene_find(names[i]), &image);
+        if (test_golden(name, names[i], &image, 1, 0))
+            result = TEST_FAIL;
+        image_free(&image);
+    }
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glGetIntegerv(GL_UNPACK_ROW_LENGTH, &row_length);
+    if (alignment != 8 || row_length != 3)
+    {
+        printf("FAIL %s: unpack alignment %d, row length %d after the "
+               "frame\n",
+               name, alignment, row_length);
+        result = TEST_FAIL;
+    }
+    test_finish();
+    return result;
+}
+
+/* Pages too small to be useful are raised to 64 pixels; a width that is
+   not a multiple of 4 still uploads rows of any length */
+static int test_atlas()
+{
+    int result = test_atlas_size("atlas-0", 0);
+
+    if (test_atlas_size("atlas-1021", 1021))
+        result = TEST_FAIL;
+    return result;
+}
+
+/* Outline glyphs larger than a 64 pixel page are skipped, the normal
+   glyphs of the same preload still fill the atlas */
+static int test_preload()
+{
+    glez_preload_stats_t stats;
+    glez_options_t options;
+    int result;
+
+    glez_options_default(&options);
+    options.atlas_page_size = 64;
+    result                  = test_start(&options);
+    if (result != TEST_PASS)
+        return result;
+    glez_font_preload(test.resources.fonts[0], GLEZ_RANGE_BASIC_LATIN,
+                      GLEZ_PRELOAD_NORMAL | GLEZ_PRELOAD_OUTLINE, 40.0f,
+                      &stats);
+    if (stats.atlas_full || stats.glyphs < 90)
+    {
+        printf("FAIL preload: %u glyphs, atlas full %d\n", stats.glyphs,
+               stats.atlas_full);
+        result = TEST_FAIL;
+    }
+    else
+        printf("ok   preload (%u glyphs)\n", stats.glyphs);
+    test_finish();
+    return result;
+}
+
+/* Once the glyphs scene is warm a frame uploads nothing; a new glyph then
+   uploads its dirty rows, far less than the 1024x1024 page */
+static int test_upload()
+{
+    const struct scene *scene = scene_find("glyphs");
+    glez_frame_stats_t stats;
+    glez_options_t options;
+    struct image image;
+    unsigned long bytes = 0;
+    int result;
+
+    glez_options_default(&options);
+    options.glyph_threads = 0;
+    result                = test_start(&options);
+    if (result != TEST_PASS)
+        return result;
+    test_render(scene, &image);
+    image_free(&image);
+    test_frame(scene, &stats);
+    if (stats.draw_calls == 0)
+    {
+        /* Built with NO_STATS */
+        test_finish();
+        return TEST_SKIP;
+    }
+    if (stats.glyph_misses || stats.atlas_upload_bytes)
+    {
+        printf("FAIL upload: warm frame has %lu glyph misses, uploads %lu "
+               "bytes\n",
+               stats.glyph_misses, stats.atlas_upload_bytes);
+        result = TEST_FAIL;
+    }
+
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        test_clear_frame();
+        glez_begin();
+        scene->draw(&test.resources, TEST_WIDTH, TEST_HEIGHT);
+        glez_string(10, 10, "\xc3\x86", test.resources.fonts[0],
+                    glez_rgba(255, 255, 255, 255), NULL, NULL);
+        glez_end();
+        glez_get_frame_stats(&stats);
+        bytes += stats.atlas_upload_bytes;
+        if (frame > 0 && stats.glyph_misses == 0 && stats.glyphs_pending == 0)
+            break;
+    }
+    if (bytes == 0 || bytes >= 1024 * 64)
+    {
+        printf("FAIL upload: a new glyph uploads %lu bytes\n", bytes);
+        result = TEST_FAIL;
+    }
+    else if (result == TEST_PASS)
+        printf("ok   upload (%lu bytes for a new glyph)\n", bytes);
+    test_finish();
+    return result;
+}
+
+/* Every vertex written for the GPU is 20 bytes: position, packed
+   texcoord, RGBA8 color and mode */
+static int test_vertex()
+{
+    static const char *names[] = { "rects", "glyphs" };
+    glez_frame_stats_t stats;
+    glez_options_t options;
+    struct image image;
+    int result;
+
+    glez_options_default(&options);
+    result = test_start(&options);
+    if (result != TEST_PASS)
+        return result;
+    for (int i = 0; i < 2; ++i)
+    {
+        const struct scene *scene = scene_find(names[i]);
+
+        test_render(scene, &image);
+        image_free(&image);
+        test_frame(scene, &stats);
+        if (stats.vertices == 0)
+        {
+            /* Built with NO_STATS */
+            result = TEST_SKIP;
+            break;
+        }
+        if (stats.vertex_upload_bytes != stats.vertices * 20)
+        {
+            printf("FAIL vertex/%s: %lu bytes for %lu vertices\n", names[i],
+                   stats.vertex_upload_bytes, stats.vertices);
+            result = TEST_FAIL;
+        }
+        else
+            printf("ok   vertex/%s (%lu bytes for %lu vertices)\n", names[i],
+                   stats.vertex_upload_bytes, stats.vertices);
+    }
+    test_finish();
+    return result;
+}
+
+/* glez_init runs outside any state guard and must leave the host's
+   vertex array and array buffer bound */
+static int test_init()
+{
+    glez_options_t options;
+    GLuint vertex_array, buffer;
+    GLint bound_vertex_array, bound_buffer;
+    int result = TEST_PASS;
+
+    glez_options_default(&options);
+    options.profile = GLEZ_PROFILE_CORE;
+    if (headless_init(options.profile) != 0)
+        return TEST_SKIP;
+    glGenVertexArrays(1, &vertex_array);
+    glBindVertexArray(vertex_array);
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glez_init_ex(TEST_WIDTH, TEST_HEIGHT, &options);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &bound_vertex_array);
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &bound_buffer);
+    if (bound_vertex_array != (GLint) vertex_array ||
+        bound_buffer != (GLint) buffer)
+    {
+        printf("FAIL init: vertex array %d and array buffer %d bound, "
+               "expected %u and %u\n",
+               bound_vertex_array, bound_buffer, vertex_array, buffer);
+        result = TEST_FAIL;
+    }
+    else
+        printf("ok   init\n");
+    glez_shutdown();
+    glDeleteBuffers(1, &buffer);
+    glDeleteVertexArrays(1, &vertex_array);
+    headless_destroy();
+    return result;
+}
+
+/* Reads a binary PPM as written by glez-replay -o, opaque */
+static int test_read_ppm(const char *path, struct image *out)
+{
+    FILE *file = fopen(path, "rb");
+    int width, height;
+
+    if (file == NULL)
+        return -1;
+    if (fscanf(file, "P6 %d %d 255", &width, &height) != 2 ||
+        fgetc(file) == EOF || width <= 0 || height <= 0)
+    {
+        fclose(file);
+        return -1;
+    }
+    out->width  = width;
+    out->height = height;
+    out->pixels = malloc((size_t) width * height * 4);
+    for (size_t i = 0; i < (size_t) width * height; ++i)
+    {
+        if (fread(out->pixels + i * 4, 1, 3, file) != 3)
+        {
+            image_free(out);
+            fclose(file);
+            return -1;
+        }
+        out->pixels[i * 4 + 3] = 255;
+    }
+    fclose(file);
+    return 0;
+}
+
+/* A list recorded in the first captured frame and only drawn in the next
+   ones, moved, replays the same last frame through glez-replay. The list
+   exists before the capture starts, so its handle comes from
+   glez_capture_start. */
+static int test_capture()
+{
+    const struct scene *scene = scene_find("mixed");
+    char capture_path[]       = "/tmp/glez-test-XXXXXX";
+    char image_path[1024];
+    char command[4096];
+    glez_options_t options;
+    struct image image, replayed;
+    glez_list_t list;
+    size_t differ;
+    int max, fd, result;
+
+    if (access(test.replay, X_OK) != 0)
+        return TEST_SKIP;
+    glez_options_default(&options);
+    result = test_start(&options);
+    if (result != TEST_PASS)
+        return result;
+    fd = mkstemp(capture_path);
+    if (fd < 0)
+    {
+        perror("mkstemp");
+        test_finish();
+        return TEST_FAIL;
+    }
+    close(fd);
+    snprintf(image_path, sizeof(image_path), "%s.ppm", capture_path);
+
+    list = glez_list_new();
+    glez_capture_start(capture_path, 3);
+    for (int frame = 0; frame < 3; ++frame)
+    {
+        /* glez-replay clears to transparent black */
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glez_begin();
+        if (!glez_list_valid(list))
+        {
+            glez_list_begin(list);
+            scene->draw(&test.resources, TEST_WIDTH, TEST_HEIGHT);
+            glez_list_end();
+        }
+        glez_list_draw(list, 8.0f, 4.0f);
+        glez_end();
+    }
+    test_read(&image);
+    glez_list_free(list);
+    test_finish();
+
+    snprintf(command, sizeof(command), "%s -n 2 -o %s %s > /dev/null",
+             test.replay, image_path, capture_path);
+    if (system(command) != 0 || test_read_ppm(image_path, &replayed) != 0)
+    {
+        printf("FAIL capture: %s failed\n", command);
+        result = TEST_FAIL;
+    }
+    else
+    {
+        for (size_t i = 0; i < TEST_WIDTH * TEST_HEIGHT; ++i)
+            image.pixels[i * 4 + 3] = 255;
+        differ = image_compare(&image, &replayed, 0, &max);
+        image_free(&replayed);
+        if (differ)
+        {
+            printf("FAIL capture: %zu replayed pixels differ, up to %d\n",
+                   differ, max);
+            test_write_failed("capture", scene->name, &image);
+            result = TEST_FAIL;
+        }
+        else
+            printf("ok   capture\n");
+    }
+    image_free(&image);
+    unlink(capture_path);
+    unlink(image_path);
+    return result;
+}
+
+static const struct test tests[] = { { "gl", test_gl },
+                                     { "core", test_core },
+                                     { "es", test_es },
+                                     { "software", test_software },
+                                     { "stream", test_stream },
+                                     { "atlas", test_atlas },
+                                     { "preload", test_preload },
+                                     { "upload", test_upload },
+                                     { "vertex", test_vertex },
+                                     { "init", test_init },
+                                     { "capture", test_capture },
+                                     { NULL, NULL } };
+
+static int test_selected(const char *name, char **names, int count)
+{
+    if (count == 0)
+        return 1;
+    for (int i = 0; i < count; ++i)
+    {
+        if (strcmp(names[i], name) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int failed  = 0;
+    int skipped = 0;
+    int option;
+    char *slash;
+
+    while ((option = getopt(argc, argv, "uf:d:o:")) != -1)
+    {
+        switch (option)
+        {
+        case 'u':
+            test.update = 1;
+            break;
+        case 'f':
+            test.font_dir = optarg;
+            break;
+        case 'd':
+            test.dir = optarg;
+            break;
+        case 'o':
+            test.failed_dir = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-u] [-f fonts] [-d dir] [-o failed] "
+                            "[test...]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    /* glez-replay is built next to glez-test */
+    slash = strrchr(argv[0], '/');
+    snprintf(test.replay, sizeof(test.replay), "%.*sglez-replay",
+             slash ? (int) (slash + 1 - argv[0]) : 0, argv[0]);
+
+    for (const struct test *t = tests; t->name; ++t)
+    {
+        if (!test_selected(t->name, argv + optind, argc - optind))
+            continue;
+        switch (t->run())
+        {
+        case TEST_FAIL:
+            failed++;
+            break;
+        case TEST_SKIP:
+            printf("skip %s\n", t->name);
+            skipped++;
+            break;
+        }
+    }
+    printf("%d failed, %d skipped\n", failed, skipped);
+    return failed ? 1 : 0;
+}
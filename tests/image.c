@@ -0,0 +1,84 @@
+#include "image.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <libpng/png.h>
+
+int image_read_png(const char *path, struct image *out)
+{
+    png_image png;
+
+    memset(out, 0, sizeof(*out));
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&png, path))
+        return -1;
+
+    png.format  = PNG_FORMAT_RGBA;
+    out->pixels = malloc(PNG_IMAGE_SIZE(png));
+    if (out->pixels == NULL ||
+        !png_image_finish_read(&png, NULL, out->pixels, 0, NULL))
+    {
+        png_image_free(&png);
+        free(out->pixels);
+        out->pixels = NULL;
+        return -1;
+    }
+    out->width  = png.width;
+    out->height = png.height;
+    return 0;
+}
+
+int image_write_png(const char *path, const struct image *image)
+{
+    png_image png;
+
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    png.width   = image->width;
+    png.height  = image->height;
+    png.format  = PNG_FORMAT_RGBA;
+    return png_image_write_to_file(&png, path, 0, image->pixels, 0, NULL)
+               ? 0
+               : -1;
+}
+
+void image_free(struct image *image)
+{
+    free(image->pixels);
+    image->pixels = NULL;
+}
+
+size_t image_compare(const struct image *a, const struct image *b,
+                     int tolerance, int *max_difference)
+{
+    size_t count  = (size_t) a->width * a->height;
+    size_t differ = 0;
+
+    *max_difference = 0;
+    if (a->width != b->width || a->height != b->height)
+    {
+        *max_difference = 255;
+        return count > (size_t) b->width * b->height
+                   ? count
+                   : (size_t) b->width * b->height;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        int worst = 0;
+
+        for (int channel = 0; channel < 4; ++channel)
+        {
+            int difference =
+                abs(a->pixels[i * 4 + channel] - b->pixels[i * 4 + channel]);
+            if (difference > worst)
+                worst = difference;
+        }
+        if (worst > *max_difference)
+            *max_difference = worst;
+        if (worst > tolerance)
+            differ++;
+    }
+    return differ;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+
+/* RGBA8 pixels, top row first */
+struct image
+{
+    int width;
+    int height;
+    unsigned char *pixels;
+};
+
+/* Returns 0, or -1 when the file is missing or not a PNG */
+int image_read_png(const char *path, struct image *out);
+
+int image_write_png(const char *path, const struct image *image);
+
+void image_free(struct image *image);
+
+/* Counts the pixels of a and b with a channel more than tolerance apart,
+   and stores the largest difference of any channel. Images of different
+   sizes differ in every pixel. */
+size_t image_compare(const struct image *a, const struct image *b,
+                     int tolerance, int *max_difference);
@@ -0,0 +1,215 @@
+#include "scenes.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Same sequence on every run and every platform */
+static unsigned scene_random(unsigned *state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static float scene_random_float(unsigned *state, float max)
+{
+    return (scene_random(state) & 0xffff) * max / 65536.0f;
+}
+
+static glez_rgba_t scene_color(unsigned i, unsigned char alpha)
+{
+    return glez_rgba(64 + (i * 37) % 192, 64 + (i * 91) % 192,
+                     64 + (i * 53) % 192, alpha);
+}
+
+int scene_load(const char *font_dir, const char *data_dir,
+               struct scene_resources *out)
+{
+    static const char *fonts[SCENE_FONTS]       = { "DejaVuSans.ttf",
+                                                    "DejaVuSerif.ttf",
+                                                    "DejaVuSansMono.ttf",
+                                                    "DejaVuSans-Bold.ttf" };
+    static const float sizes[SCENE_FONTS]       = { 10, 10, 9, 10 };
+    static const char *textures[SCENE_TEXTURES] = { "checker.png",
+                                                    "gradient.png" };
+    char path[1024];
+
+    for (int i = 0; i < SCENE_FONTS; ++i)
+    {
+        snprintf(path, sizeof(path), "%s/%s", font_dir, fonts[i]);
+        out->fonts[i] = glez_font_load(path, sizes[i]);
+        if (out->fonts[i] == GLEZ_FONT_INVALID)
+        {
+            fprintf(stderr, "scenes: could not load %s\n", path);
+            return -1;
+        }
+    }
+    for (int i = 0; i < SCENE_TEXTURES; ++i)
+    {
+        snprintf(path, sizeof(path), "%s/%s", data_dir, textures[i]);
+        out->textures[i] = glez_texture_load_png_rgba(path);
+        if (out->textures[i] == GLEZ_TEXTURE_INVALID)
+        {
+            fprintf(stderr, "scenes: could not load %s\n", path);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void scene_unload(struct scene_resources *resources)
+{
+    for (int i = 0; i < SCENE_FONTS; ++i)
+        glez_font_unload(resources->fonts[i]);
+    for (int i = 0; i < SCENE_TEXTURES; ++i)
+        glez_texture_unload(resources->textures[i]);
+}
+
+/* 10,000 translucent rects on a 100x100 grid */
+static void scene_rects(const struct scene_resources *resources, int width,
+                        int height)
+{
+    float w = width / 100.0f;
+    float h = height / 100.0f;
+
+    for (unsigned i = 0; i < 10000; ++i)
+    {
+        float x = (i % 100) * w;
+        float y = (i / 100) * h;
+
+        glez_rect(x, y, w * 1.5f, h * 1.5f, scene_color(i, 160));
+    }
+}
+
+/* 10,000 lines of 1 to 2 pixels between random points */
+static void scene_lines(const struct scene_resources *resources, int width,
+                        int height)
+{
+    unsigned state = 1;
+
+    for (unsigned i = 0; i < 10000; ++i)
+    {
+        float x  = scene_random_float(&state, width);
+        float y  = scene_random_float(&state, height);
+        float dx = scene_random_float(&state, 80) - 40;
+        float dy = scene_random_float(&state, 80) - 40;
+
+        glez_line(x, y, dx, dy, scene_color(i, 128), 1.0f + (i % 3) * 0.5f);
+    }
+}
+
+/* 50,000 glyphs: 1,000 strings of 50 characters, a quarter per font */
+static void scene_glyphs(const struct scene_resources *resources, int width,
+                         int height)
+{
+    static const char text[] = "The quick brown fox jumps over the lazy dog. "
+                               "Sphinx of black quartz, judge my vow! ";
+    static char strings[1000][51];
+
+    for (unsigned i = 0; i < 1000; ++i)
+    {
+        if (strings[i][0] == 0)
+            snprintf(strings[i], sizeof(strings[i]), "%04u %.45s", i,
+                     text + i % 40);
+        glez_string((i % 4) * width / 4.0f, (i / 4) * height / 250.0f,
+                    strings[i], resources->fonts[i % SCENE_FONTS],
+                    scene_color(i, 255), NULL, NULL);
+    }
+}
+
+/* Textured rects alternating between two textures, with a glyph of one of
+   the fonts over each, so every texture slot changes often */
+static void scene_textures(const struct scene_resources *resources,
+                           int width, int height)
+{
+    float w = width / 40.0f;
+    float h = height / 25.0f;
+
+    for (unsigned i = 0; i < 1000; ++i)
+    {
+        float x = (i % 40) * w;
+        float y = (i / 40) * h;
+
+        glez_rect_textured(x, y, w, h, glez_rgba(255, 255, 255, 255),
+                           resources->textures[i % SCENE_TEXTURES], 0, 0, 32,
+                           32);
+        glez_string(x + 2, y, i % 2 ? "x" : "g",
+                    resources->fonts[(i / 2) % SCENE_FONTS],
+                    glez_rgba(255, 255, 255, 255), NULL, NULL);
+    }
+}
+
+/* 100 circle outlines of 256 steps */
+static void scene_circles(const struct scene_resources *resources,
+                          int width, int height)
+{
+    for (unsigned i = 0; i < 100; ++i)
+    {
+        float radius = 10 + (i % 10) * height / 25.0f;
+
+        glez_circle((i / 10 + 0.5f) * width / 10.0f, height / 2.0f, radius,
+                    scene_color(i, 200), 1.0f + (i % 4) * 0.5f, 256);
+    }
+}
+
+/* Fill rate: 8 translucent full-frame rects, then 8 textured ones, so
+   the fragment shader dominates the frame */
+static void scene_fill(const struct scene_resources *resources, int width,
+                       int height)
+{
+    for (unsigned i = 0; i < 8; ++i)
+        glez_rect(0, 0, width, height, scene_color(i, 32));
+    for (unsigned i = 0; i < 8; ++i)
+        glez_rect_textured(0, 0, width, height, glez_rgba(255, 255, 255, 32),
+                           resources->textures[i % SCENE_TEXTURES], 0, 0, 32,
+                           32);
+}
+
+/* A bit of everything, as an overlay would draw it */
+static void scene_mixed(const struct scene_resources *resources, int width,
+                        int height)
+{
+    for (int i = 0; i < 100; ++i)
+        glez_rect(i * width / 200.0f, i * height / 150.0f, 20, 10,
+                  glez_rgba(255, i * 2, 0, 128));
+    for (int i = 0; i < 50; ++i)
+        glez_line(0, i * height / 50.0f, width - 40, i * height / 150.0f,
+                  glez_rgba(0, 255, 0, 200), 1.5f);
+    glez_rect_outline(20, 20, width - 40, height - 40,
+                      glez_rgba(255, 255, 255, 255), 2);
+    for (int i = 0; i * 14 < height; ++i)
+    {
+        glez_string(10, i * 14, "Hello, glez! 0123", resources->fonts[0],
+                    glez_rgba(255, 255, 255, 255), NULL, NULL);
+        glez_string_with_outline(width / 2.0f, i * 14, "Outlined AVWa",
+                                 resources->fonts[1 + i % 3],
+                                 glez_rgba(255, 255, 0, 255),
+                                 glez_rgba(0, 0, 0, 255), 1.0f, 1, NULL,
+                                 NULL);
+    }
+    for (int i = 0; i < 6; ++i)
+        glez_rect_textured(width - 190 + i * 30, height - 180 + i * 20, 64, 64,
+                           glez_rgba(255, 255, 255, 255),
+                           resources->textures[i % SCENE_TEXTURES], 0, 0, 32,
+                           32);
+    glez_rect_textured(width - 140, 20, 100, 50, glez_rgba(255, 255, 255, 200),
+                       resources->textures[0], 8, 8, 16, 16);
+    glez_circle(width / 2.0f, height / 2.0f, height / 5.0f,
+                glez_rgba(255, 0, 255, 255), 2, 64);
+}
+
+const struct scene scenes[] = {
+    { "rects", scene_rects },     { "lines", scene_lines },
+    { "glyphs", scene_glyphs },   { "textures", scene_textures },
+    { "circles", scene_circles }, { "fill", scene_fill },
+    { "mixed", scene_mixed },     { NULL, NULL }
+};
+
+const struct scene *scene_find(const char *name)
+{
+    for (const struct scene *scene = scenes; scene->name; ++scene)
+    {
+        if (strcmp(scene->name, name) == 0)
+            return scene;
+    }
+    return NULL;
+}
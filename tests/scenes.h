@@ -0,0 +1,34 @@
+#pragma once
+
+#include "glez.h"
+
+/* Scripted scenes shared by glez-test and glez-bench. A scene draws the
+   same thing on every call, scaled to the frame size. */
+
+#define SCENE_FONTS 4
+#define SCENE_TEXTURES 2
+
+struct scene_resources
+{
+    glez_font_t fonts[SCENE_FONTS];
+    glez_texture_t textures[SCENE_TEXTURES];
+};
+
+/* Loads DejaVu Sans, Serif, Sans Mono and Sans Bold from font_dir, and the
+   textures of data_dir. Returns 0, or -1 after printing what is missing. */
+int scene_load(const char *font_dir, const char *data_dir,
+               struct scene_resources *out);
+
+void scene_unload(struct scene_resources *resources);
+
+struct scene
+{
+    const char *name;
+    void (*draw)(const struct scene_resources *resources, int width,
+                 int height);
+};
+
+/* NULL-terminated */
+extern const struct scene scenes[];
+
+const struct scene *scene_find(const char *name);
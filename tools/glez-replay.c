@@ -0,0 +1,626 @@
+/* Replays a file written by glez_capture_start in a loop, headless, and
+   reports frame times and the glez counters.
+
+   glez-replay [-n loops] [-s] [-t threads] [-g] [-a] [-o image.ppm] capture
+
+   -n  times the captured frames are replayed, 100 by default. The first
+       pass loads glyphs and is reported on its own.
+   -s  GLEZ_BACKEND_SOFTWARE with -t threads, no GL context is created
+   -g  GPU time with GLEZ_GPU_TIMING_FRAME
+   -a  shares atlas pages between fonts, glez_options_t.shared_atlas
+   -o  writes the last replayed frame as a binary PPM */
+
+#include <GL/glew.h>
+
+#include "glez.h"
+#include "headless.h"
+#include "internal/capture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* The fixed part of any record. Records follow strings of any length, so
+   they are copied out of the file before their fields are read. */
+union replay_payload
+{
+    struct capture_handle handle;
+    struct capture_font font;
+    struct capture_font_preload font_preload;
+    struct capture_resize resize;
+    struct capture_line line;
+    struct capture_rect rect;
+    struct capture_rect_textured rect_textured;
+    struct capture_string string;
+    struct capture_string_outline string_outline;
+    struct capture_circle circle;
+    struct capture_list_draw list_draw;
+};
+
+struct replay_op
+{
+    int op;
+    union replay_payload payload;
+    /* NUL-terminated copy of the string after the payload */
+    char *string;
+};
+
+struct replay_state
+{
+    struct replay_op *ops;
+    size_t count;
+    size_t frames;
+    int width;
+    int height;
+    glez_font_t fonts[GLEZ_FONT_COUNT];
+    glez_texture_t textures[GLEZ_TEXTURE_COUNT];
+    glez_list_t lists[GLEZ_LIST_COUNT];
+
+    int software;
+    unsigned char *pixels;
+} replay;
+
+static const size_t replay_payload_size[CAPTURE_OP_COUNT] = {
+    [CAPTURE_OP_FONT]           = sizeof(struct capture_font),
+    [CAPTURE_OP_FONT_UNLOAD]    = sizeof(struct capture_handle),
+    [CAPTURE_OP_TEXTURE]        = sizeof(struct capture_handle),
+    [CAPTURE_OP_TEXTURE_UNLOAD] = sizeof(struct capture_handle),
+    [CAPTURE_OP_RESIZE]         = sizeof(struct capture_resize),
+    [CAPTURE_OP_LINE]           = sizeof(struct capture_line),
+    [CAPTURE_OP_RECT]           = sizeof(struct capture_rect),
+    [CAPTURE_OP_RECT_OUTLINE]   = sizeof(struct capture_line),
+    [CAPTURE_OP_RECT_TEXTURED]  = sizeof(struct capture_rect_textured),
+    [CAPTURE_OP_STRING]         = sizeof(struct capture_string),
+    [CAPTURE_OP_STRING_OUTLINE] = sizeof(struct capture_string_outline),
+    [CAPTURE_OP_CIRCLE]         = sizeof(struct capture_circle),
+    [CAPTURE_OP_STRING_SIZE]    = sizeof(struct capture_handle),
+    [CAPTURE_OP_FONT_PRELOAD]   = sizeof(struct capture_font_preload),
+    [CAPTURE_OP_LIST_NEW]       = sizeof(struct capture_handle),
+    [CAPTURE_OP_LIST_FREE]      = sizeof(struct capture_handle),
+    [CAPTURE_OP_LIST_BEGIN]     = sizeof(struct capture_handle),
+    [CAPTURE_OP_LIST_DRAW]      = sizeof(struct capture_list_draw),
+};
+
+static double replay_now()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void *replay_read_file(const char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    void *data;
+    long length;
+
+    if (file == NULL)
+    {
+        perror(path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data = malloc(length > 0 ? length : 1);
+    if (length < 0 || fread(data, 1, length, file) != (size_t) length)
+    {
+        perror(path);
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    *size = length;
+    return data;
+}
+
+static void replay_resize(int width, int height)
+{
+    replay.width  = width;
+    replay.height = height;
+    if (replay.software)
+    {
+        free(replay.pixels);
+        replay.pixels = calloc((size_t) width * height, 4);
+        glez_software_target(replay.pixels, width * 4);
+        return;
+    }
+    headless_resize(width, height);
+}
+
+/* Loads the resources and remaps their handles, so records read the
+   handles of this process */
+static int replay_parse(unsigned char *data, size_t size)
+{
+    size_t offset = sizeof(struct capture_header);
+    size_t end    = 0;
+    /* Inside the recording of a list this process has no handle for */
+    int skip_list = 0;
+
+    replay.ops = calloc(size / sizeof(uint32_t), sizeof(struct replay_op));
+    memset(replay.fonts, 0xff, sizeof(replay.fonts));
+    memset(replay.textures, 0xff, sizeof(replay.textures));
+    memset(replay.lists, 0xff, sizeof(replay.lists));
+
+    while (offset + sizeof(uint32_t) <= size)
+    {
+        uint32_t tag;
+        struct replay_op *op = &replay.ops[replay.count];
+
+        /* Slots of skipped records are reused */
+        free(op->string);
+        op->string = NULL;
+
+        memcpy(&tag, data + offset, sizeof(tag));
+        offset += sizeof(tag);
+
+        int op_code   = tag & 0xff;
+        size_t length = tag >> 8;
+        if (op_code <= 0 || op_code >= CAPTURE_OP_COUNT ||
+            offset + length > size || length < replay_payload_size[op_code])
+        {
+            fprintf(stderr, "glez-replay: bad record at offset %zu\n",
+                    offset - sizeof(tag));
+            return -1;
+        }
+
+        union replay_payload *payload = &op->payload;
+        size_t fixed                  = replay_payload_size[op_code];
+
+        op->op = op_code;
+        memcpy(payload, data + offset, fixed);
+        if (op_code == CAPTURE_OP_FONT || op_code == CAPTURE_OP_TEXTURE ||
+            op_code == CAPTURE_OP_STRING ||
+            op_code == CAPTURE_OP_STRING_OUTLINE ||
+            op_code == CAPTURE_OP_STRING_SIZE)
+            op->string =
+                strndup((char *) data + offset + fixed, length - fixed);
+        offset += length;
+
+        if (skip_list)
+        {
+            skip_list = op_code != CAPTURE_OP_LIST_END;
+            continue;
+        }
+
+        switch (op_code)
+        {
+        case CAPTURE_OP_FONT:
+        {
+            struct capture_font *record = &payload->font;
+            glez_font_t font = glez_font_load(op->string, record->size);
+            if (font == GLEZ_FONT_INVALID)
+                fprintf(stderr, "glez-replay: could not load font %s\n",
+                        op->string);
+            if (record->handle < GLEZ_FONT_COUNT)
+                replay.fonts[record->handle] = font;
+            continue;
+        }
+        case CAPTURE_OP_TEXTURE:
+        {
+            struct capture_handle *record = &payload->handle;
+            glez_texture_t texture = glez_texture_load_png_rgba(op->string);
+            if (texture == GLEZ_TEXTURE_INVALID)
+                fprintf(stderr, "glez-replay: could not load texture %s\n",
+                        op->string);
+            if (record->handle < GLEZ_TEXTURE_COUNT)
+                replay.textures[record->handle] = texture;
+            continue;
+        }
+        case CAPTURE_OP_FONT_PRELOAD:
+        {
+            /* Like loads, done once before the passes */
+            struct capture_font_preload *record = &payload->font_preload;
+            if (record->font < GLEZ_FONT_COUNT &&
+                replay.fonts[record->font] != GLEZ_FONT_INVALID)
+                glez_font_preload(replay.fonts[record->font], record->ranges,
+                                  record->flags, record->outline_width, NULL);
+            continue;
+        }
+        case CAPTURE_OP_LIST_NEW:
+        {
+            /* Like loads: the list is recorded again by every pass */
+            struct capture_handle *record = &payload->handle;
+            glez_list_t list              = glez_list_new();
+            if (list == GLEZ_LIST_INVALID)
+                fprintf(stderr, "glez-replay: out of lists\n");
+            if (record->handle < GLEZ_LIST_COUNT)
+                replay.lists[record->handle] = list;
+            continue;
+        }
+        case CAPTURE_OP_FONT_UNLOAD:
+        case CAPTURE_OP_TEXTURE_UNLOAD:
+        case CAPTURE_OP_LIST_FREE:
+            /* Everything stays loaded for the next pass */
+            continue;
+        case CAPTURE_OP_LIST_BEGIN:
+        case CAPTURE_OP_LIST_DRAW:
+        {
+            uint32_t *list = op_code == CAPTURE_OP_LIST_BEGIN
+                                 ? &payload->handle.handle
+                                 : &payload->list_draw.list;
+            *list = *list < GLEZ_LIST_COUNT ? replay.lists[*list]
+                                            : GLEZ_LIST_INVALID;
+            if (*list == GLEZ_LIST_INVALID)
+            {
+                /* Its draws would not be recorded into anything */
+                skip_list = op_code == CAPTURE_OP_LIST_BEGIN;
+                continue;
+            }
+            break;
+        }
+        case CAPTURE_OP_RECT_TEXTURED:
+        {
+            struct capture_rect_textured *record = &payload->rect_textured;
+            record->texture = record->texture < GLEZ_TEXTURE_COUNT
+                                  ? replay.textures[record->texture]
+                                  : GLEZ_TEXTURE_INVALID;
+            if (record->texture == GLEZ_TEXTURE_INVALID)
+                continue;
+            break;
+        }
+        case CAPTURE_OP_STRING:
+        case CAPTURE_OP_STRING_OUTLINE:
+        case CAPTURE_OP_STRING_SIZE:
+        {
+            uint32_t *font = op_code == CAPTURE_OP_STRING_SIZE
+                                 ? &payload->handle.handle
+                             : op_code == CAPTURE_OP_STRING
+                                 ? &payload->string.font
+                                 : &payload->string_outline.font;
+            *font = *font < GLEZ_FONT_COUNT ? replay.fonts[*font]
+                                            : GLEZ_FONT_INVALID;
+            if (*font == GLEZ_FONT_INVALID)
+                continue;
+            break;
+        }
+        case CAPTURE_OP_END:
+            replay.frames++;
+            end = replay.count + 1;
+            break;
+        }
+        replay.count++;
+    }
+
+    /* Drop a frame cut short by glez_capture_stop */
+    replay.count = end;
+    return 0;
+}
+
+static void replay_execute(const struct replay_op *op)
+{
+    const void *payload = &op->payload;
+
+    switch (op->op)
+    {
+    case CAPTURE_OP_RESIZE:
+    {
+        const struct capture_resize *record = payload;
+        replay_resize(record->width, record->height);
+        glez_resize(record->width, record->height);
+        break;
+    }
+    case CAPTURE_OP_BEGIN:
+        glez_begin();
+        break;
+    case CAPTURE_OP_END:
+        glez_end();
+        break;
+    case CAPTURE_OP_LINE:
+    {
+        const struct capture_line *record = payload;
+        glez_line(record->x, record->y, record->dx, record->dy, record->color,
+                  record->thickness);
+        break;
+    }
+    case CAPTURE_OP_RECT:
+    {
+        const struct capture_rect *record = payload;
+        glez_rect(record->x, record->y, record->w, record->h, record->color);
+        break;
+    }
+    case CAPTURE_OP_RECT_OUTLINE:
+    {
+        const struct capture_line *record = payload;
+        glez_rect_outline(record->x, record->y, record->dx, record->dy,
+                          record->color, record->thickness);
+        break;
+    }
+    case CAPTURE_OP_RECT_TEXTURED:
+    {
+        const struct capture_rect_textured *record = payload;
+        glez_rect_textured(record->x, record->y, record->w, record->h,
+                           record->color, record->texture, record->tx,
+                           record->ty, record->tw, record->th);
+        break;
+    }
+    case CAPTURE_OP_STRING:
+    {
+        const struct capture_string *record = payload;
+        glez_string(record->x, record->y, op->string, record->font,
+                    record->color, NULL, NULL);
+        break;
+    }
+    case CAPTURE_OP_STRING_OUTLINE:
+    {
+        const struct capture_string_outline *record = payload;
+        glez_string_with_outline(record->x, record->y, op->string,
+                                 record->font, record->color,
+                                 record->outline_color, record->outline_width,
+                                 record->adjust_outline_alpha, NULL, NULL);
+        break;
+    }
+    case CAPTURE_OP_CIRCLE:
+    {
+        const struct capture_circle *record = payload;
+        glez_circle(record->x, record->y, record->radius, record->color,
+                    record->thickness, record->steps);
+        break;
+    }
+    case CAPTURE_OP_STRING_SIZE:
+    {
+        const struct capture_handle *record = payload;
+        glez_font_string_size(record->handle, op->string, NULL, NULL);
+        break;
+    }
+    case CAPTURE_OP_LIST_BEGIN:
+    {
+        const struct capture_handle *record = payload;
+        glez_list_begin(record->handle);
+        break;
+    }
+    case CAPTURE_OP_LIST_END:
+        glez_list_end();
+        break;
+    case CAPTURE_OP_LIST_DRAW:
+    {
+        const struct capture_list_draw *record = payload;
+        glez_list_draw(record->list, record->dx, record->dy);
+        break;
+    }
+    }
+}
+
+static void replay_clear()
+{
+    if (replay.software)
+    {
+        memset(replay.pixels, 0, (size_t) replay.width * replay.height * 4);
+        return;
+    }
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+/* Replays every frame once. Frame times include glFinish, counters are
+   summed into totals. */
+static void replay_pass(double *times, glez_frame_stats_t *totals)
+{
+    double start = 0.0;
+
+    for (size_t i = 0; i < replay.count; ++i)
+    {
+        const struct replay_op *op = &replay.ops[i];
+
+        if (op->op == CAPTURE_OP_BEGIN)
+        {
+            replay_clear();
+            if (!replay.software)
+                glFinish();
+            start = replay_now();
+        }
+        replay_execute(op);
+        if (op->op != CAPTURE_OP_END)
+            continue;
+
+        glez_frame_stats_t frame;
+        if (!replay.software)
+            glFinish();
+        *times++ = (replay_now() - start) * 1000.0;
+
+        glez_get_frame_stats(&frame);
+        totals->draw_calls += frame.draw_calls;
+        totals->texture_flushes += frame.texture_flushes;
+        totals->vertices += frame.vertices;
+        totals->vertex_upload_bytes += frame.vertex_upload_bytes;
+        totals->atlas_upload_bytes += frame.atlas_upload_bytes;
+        totals->glyph_hits += frame.glyph_hits;
+        totals->glyph_misses += frame.glyph_misses;
+        totals->glyphs_rasterized += frame.glyphs_rasterized;
+        totals->layout_hits += frame.layout_hits;
+        totals->layout_misses += frame.layout_misses;
+        totals->atlas_pages = frame.atlas_pages;
+        totals->record_ms += frame.record_ms;
+        totals->end_ms += frame.end_ms;
+        totals->flush_ms += frame.flush_ms;
+    }
+}
+
+static int replay_compare(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+static void replay_report(const char *name, double *times, size_t count,
+                          const glez_frame_stats_t *totals)
+{
+    double sum = 0.0;
+
+    qsort(times, count, sizeof(double), replay_compare);
+    for (size_t i = 0; i < count; ++i)
+        sum += times[i];
+    printf("%s: %zu frames, ms/frame avg %.3f min %.3f p50 %.3f p99 %.3f "
+           "max %.3f\n",
+           name, count, sum / count, times[0], times[count / 2],
+           times[(count * 99) / 100], times[count - 1]);
+    printf("  per frame: %.1f draw calls, %.1f texture flushes, %.0f "
+           "vertices, %.0f vertex bytes, %.0f atlas bytes\n",
+           (double) totals->draw_calls / count,
+           (double) totals->texture_flushes / count,
+           (double) totals->vertices / count,
+           (double) totals->vertex_upload_bytes / count,
+           (double) totals->atlas_upload_bytes / count);
+    printf("  glyphs: %.1f hits, %.1f misses, %.1f rasterized; layouts: "
+           "%.1f hits, %.1f misses\n",
+           (double) totals->glyph_hits / count,
+           (double) totals->glyph_misses / count,
+           (double) totals->glyphs_rasterized / count,
+           (double) totals->layout_hits / count,
+           (double) totals->layout_misses / count);
+    printf("  atlas pages: %lu\n", totals->atlas_pages);
+    printf("  cpu ms: record %.3f end %.3f flush %.3f\n",
+           totals->record_ms / count, totals->end_ms / count,
+           totals->flush_ms / count);
+}
+
+static void replay_write_image(const char *path)
+{
+    unsigned char *pixels = replay.pixels;
+
+    if (!replay.software)
+    {
+        pixels = malloc((size_t) replay.width * replay.height * 4);
+        headless_read(pixels);
+    }
+    headless_write_ppm(path, pixels, replay.width, replay.height);
+    if (!replay.software)
+        free(pixels);
+}
+
+int main(int argc, char **argv)
+{
+    glez_options_t options;
+    struct capture_header header;
+    const char *image = NULL;
+    int loops         = 100;
+    int gpu_timing    = 0;
+    int threads       = 0;
+    int shared_atlas  = 0;
+    int option;
+    unsigned char *data;
+    size_t size;
+
+    while ((option = getopt(argc, argv, "n:st:gao:")) != -1)
+    {
+        switch (option)
+        {
+        case 'n':
+            loops = atoi(optarg);
+            break;
+        case 's':
+            replay.software = 1;
+            break;
+        case 't':
+            threads = atoi(optarg);
+            break;
+        case 'g':
+            gpu_timing = 1;
+            break;
+        case 'a':
+            shared_atlas = 1;
+            break;
+        case 'o':
+            image = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n loops] [-s] [-t threads] [-g] "
+                            "[-a] [-o image.ppm] capture\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (optind != argc - 1 || loops < 1)
+    {
+        fprintf(stderr, "usage: %s [-n loops] [-s] [-t threads] [-g] "
+                        "[-a] [-o image.ppm] capture\n",
+                argv[0]);
+        return 2;
+    }
+
+    data = replay_read_file(argv[optind], &size);
+    if (data == NULL)
+        return 1;
+    if (size < sizeof(header))
+    {
+        fprintf(stderr, "glez-replay: %s is too short\n", argv[optind]);
+        return 1;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != CAPTURE_MAGIC || header.version != CAPTURE_VERSION)
+    {
+        fprintf(stderr, "glez-replay: %s is not a version %d capture\n",
+                argv[optind], CAPTURE_VERSION);
+        return 1;
+    }
+
+    if (!replay.software)
+    {
+        if (headless_init(GLEZ_PROFILE_COMPATIBILITY) != 0)
+            return 1;
+        printf("renderer: %s, %s\n", glGetString(GL_RENDERER),
+               glGetString(GL_VERSION));
+    }
+    replay_resize(header.width, header.height);
+
+    glez_options_default(&options);
+    if (replay.software)
+    {
+        options.backend          = GLEZ_BACKEND_SOFTWARE;
+        options.software_target  = replay.pixels;
+        options.software_stride  = header.width * 4;
+        options.software_threads = threads;
+    }
+    if (gpu_timing)
+        options.gpu_timing = GLEZ_GPU_TIMING_FRAME;
+    options.shared_atlas = shared_atlas;
+    glez_init_ex(header.width, header.height, &options);
+
+    if (replay_parse(data, size) != 0)
+        return 1;
+    if (replay.frames == 0)
+    {
+        fprintf(stderr, "glez-replay: no complete frame in %s\n",
+                argv[optind]);
+        return 1;
+    }
+    printf("%s: %dx%d, %zu frames, %zu records, %zu bytes\n", argv[optind],
+           header.width, header.height, replay.frames, replay.count, size);
+
+    double *times = calloc(replay.frames * loops, sizeof(double));
+    glez_frame_stats_t totals;
+
+    memset(&totals, 0, sizeof(totals));
+    replay_pass(times, &totals);
+    replay_report("first pass", times, replay.frames, &totals);
+
+    if (loops > 1)
+    {
+        memset(&totals, 0, sizeof(totals));
+        for (int i = 1; i < loops; ++i)
+            replay_pass(times + replay.frames * (i - 1), &totals);
+        replay_report("replay", times, replay.frames * (loops - 1), &totals);
+    }
+
+    if (gpu_timing)
+    {
+        glez_gpu_stats_t gpu;
+
+        glez_get_gpu_stats(&gpu);
+        printf("gpu ms/frame: avg %.3f min %.3f p99 %.3f (%u samples, %lu "
+               "dropped)\n",
+               gpu.avg_ms, gpu.min_ms, gpu.p99_ms, gpu.samples, gpu.dropped);
+    }
+    if (image)
+        replay_write_image(image);
+
+    glez_shutdown();
+    headless_destroy();
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "glez.h"
+#include "headless.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct
+{
+    EGLDisplay display;
+    EGLContext context;
+    GLuint framebuffer;
+    GLuint renderbuffer;
+    int width;
+    int height;
+} headless;
+
+int headless_init(int profile)
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress(
+            "eglGetPlatformDisplayEXT");
+    EGLint compatibility[] = { EGL_CONTEXT_MAJOR_VERSION, 3,
+                               EGL_CONTEXT_MINOR_VERSION, 0, EGL_NONE };
+    EGLint core[] = { EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION,
+                      3, EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                      EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+    /* ES 3.0 takes the same attributes as GL 3.0 */
+    EGLint *attributes = profile == GLEZ_PROFILE_CORE ? core : compatibility;
+    EGLenum api =
+        profile == GLEZ_PROFILE_ES ? EGL_OPENGL_ES_API : EGL_OPENGL_API;
+    GLenum error;
+
+    headless.display = EGL_NO_DISPLAY;
+    if (get_platform_display)
+        headless.display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                                EGL_DEFAULT_DISPLAY, NULL);
+    if (headless.display == EGL_NO_DISPLAY)
+        headless.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (!eglInitialize(headless.display, NULL, NULL) || !eglBindAPI(api))
+    {
+        fprintf(stderr, "headless: EGL initialization failed\n");
+        return -1;
+    }
+    headless.context = eglCreateContext(headless.display, EGL_NO_CONFIG_KHR,
+                                        EGL_NO_CONTEXT, attributes);
+    if (headless.context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(headless.display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                        headless.context))
+    {
+        fprintf(stderr, "headless: could not create a %s 3.%d context\n",
+                profile == GLEZ_PROFILE_ES ? "GLES" : "GL",
+                profile == GLEZ_PROFILE_CORE ? 3 : 0);
+        return -1;
+    }
+
+    glewExperimental = GL_TRUE;
+    error            = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    /* GLX-only GLEW still loads the GL entry points */
+    if (error == GLEW_ERROR_NO_GLX_DISPLAY)
+        error = GLEW_OK;
+#endif
+    if (error != GLEW_OK)
+    {
+        fprintf(stderr, "headless: %s\n", glewGetErrorString(error));
+        return -1;
+    }
+
+    glGenFramebuffers(1, &headless.framebuffer);
+    glGenRenderbuffers(1, &headless.renderbuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, headless.framebuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, headless.renderbuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, headless.renderbuffer);
+    return 0;
+}
+
+void headless_destroy()
+{
+    if (headless.context == EGL_NO_CONTEXT)
+        return;
+    glDeleteRenderbuffers(1, &headless.renderbuffer);
+    glDeleteFramebuffers(1, &headless.framebuffer);
+    eglMakeCurrent(headless.display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   EGL_NO_CONTEXT);
+    eglDestroyContext(headless.display, headless.context);
+    headless.context = EGL_NO_CONTEXT;
+}
+
+void headless_resize(int width, int height)
+{
+    headless.width  = width;
+    headless.height = height;
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glViewport(0, 0, width, height);
+}
+
+void headless_read(unsigned char *pixels)
+{
+    size_t row          = (size_t) headless.width * 4;
+    unsigned char *line = malloc(row);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, headless.width, headless.height, GL_RGBA,
+                 GL_UNSIGNED_BYTE, pixels);
+    /* GL rows start at the bottom */
+    for (int y = 0; y < headless.height / 2; ++y)
+    {
+        unsigned char *top    = pixels + y * row;
+        unsigned char *bottom = pixels + (headless.height - 1 - y) * row;
+
+        memcpy(line, top, row);
+        memcpy(top, bottom, row);
+        memcpy(bottom, line, row);
+    }
+    free(line);
+}
+
+int headless_write_ppm(const char *path, const unsigned char *pixels,
+                       int width, int height)
+{
+    FILE *file = fopen(path, "wb");
+
+    if (file == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    fprintf(file, "P6 %d %d 255\n", width, height);
+    for (size_t i = 0; i < (size_t) width * height; ++i)
+        fwrite(pixels + i * 4, 1, 3, file);
+    fclose(file);
+    return 0;
+}
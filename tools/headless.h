@@ -0,0 +1,21 @@
+#pragma once
+
+/* Offscreen GL context shared by glez-replay, the tests and the
+   benchmarks: an EGL context without a surface, Mesa llvmpipe on a
+   machine without a GPU, drawing into an RGBA8 framebuffer object. */
+
+/* Creates a context for a GLEZ_PROFILE_* and makes it current. Returns 0,
+   or -1 after printing why. */
+int headless_init(int profile);
+
+void headless_destroy();
+
+/* Resizes the framebuffer and sets the viewport to it */
+void headless_resize(int width, int height);
+
+/* Reads the framebuffer as RGBA8, top row first */
+void headless_read(unsigned char *pixels);
+
+/* Writes RGBA8 pixels, top row first, as a binary PPM. Returns 0 or -1. */
+int headless_write_ppm(const char *path, const unsigned char *pixels,
+                       int width, int height);